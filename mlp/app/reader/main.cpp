@@ -1,6 +1,7 @@
 #include <fstream>
 #include <filesystem>
 #include <iostream>
+#include <set>
 #include <string>
 
 #include "argparser.h"
@@ -63,6 +64,9 @@ int main(int argc, char** argv)
 	if (!options.sfolder.empty()) {
 		print_csv_line("Instance", "Gap");
 		auto sdirpath = std::string(DATAPATH) + "/" + options.sfolder;
+		// Instances of the solutions read so far, kept alive so
+		// that the registry parses each one only once
+		std::set<std::shared_ptr<Instance>> instances;
 		for (const auto& entry : fs::directory_iterator(sdirpath)) {
 			auto path = entry.path();
 			if (path.extension() != ".sol")
@@ -74,6 +78,7 @@ int main(int argc, char** argv)
 				continue; // Do not stop iterating
 			}
 			options.display_solution_info(solution);
+			instances.insert(solution.GetInstance());
 		}
 	}
 
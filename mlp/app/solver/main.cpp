@@ -1,7 +1,10 @@
+#include <cassert>
 #include <filesystem>
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <deque>
+#include <future>
 
 #include "ils.h"
 #include "genetic.h"
@@ -9,7 +12,10 @@
 
 #include "csv.h"
 
+#include "cache.h"
 #include "iparser.h"
+#include "registry.h"
+#include "segment.h"
 #include "argparser.h"
 #include "solution.h"
 
@@ -31,18 +37,33 @@ struct options_t
 	std::string ifolder;
 	std::string sfile;
 	std::string heuristic;
+	std::string gamma_strategy;
+	std::string ls_order;
+	std::string ls_descent;
+	std::size_t ls_threads = 0;
+	std::string perturbation_type;
+	bool ls_chain = false;
 	unsigned long long max_iterations_sli = 0;
 	unsigned long long max_seconds_sli = 0;
 	
 	unsigned int seed = 0;
 	std::size_t gammak = 0;
+	std::size_t max_dimension = 0;
+	std::size_t threads = 0;
+	std::size_t prefetch = 0;
+	std::size_t prefetch_threads = 0;
 	float gap_threshhold = 0;
 	bool does_save = false;
 	bool verbose = true;
 	bool validate = false;
+	bool shm = false;
+	bool shm_remove = false;
+	bool no_cache = false;
 
 	unsigned long long ils_decay_factor = 0;
 	float ils_perturbation_factor = 0;
+	std::size_t ils_dp_window = 0;
+	std::size_t ils_dp_period = 0;
 
 	std::size_t gen_minsize = 0;
 	std::size_t gen_maxsize = 0;
@@ -60,6 +81,125 @@ struct options_t
 	char csvDecimalSeparator = 0;
 	std::unique_ptr<csv::writer> csvWriter;
 
+	std::string statspath;
+	std::unique_ptr<csv::writer> statsWriter;
+
+	// Gamma set options given by --gamma-strategy and --gamma-k
+	Instance::Config get_instance_config() const {
+		Instance::Config config;
+		if (gamma_strategy == "grid")
+			config.strategy = ds::GammaSet::Strategy::Grid;
+		else if (gamma_strategy == "quadrant")
+			config.strategy = ds::GammaSet::Strategy::Quadrant;
+		else if (gamma_strategy == "alpha")
+			config.strategy = ds::GammaSet::Strategy::Alpha;
+		else if (gamma_strategy == "alpha-ascent")
+			config.strategy = ds::GammaSet::Strategy::AlphaAscent;
+		if (gammak)
+			config.k = gammak;
+		return config;
+	}
+
+	// Parses only the instance specification
+	// (see load_instance)
+	// Instances of the registry already have the gamma set
+	// options (see InstanceRegistry::SetDefaultConfig)
+	std::optional<SharedInstance> open_instance(std::string const& path) const {
+		if (shm) {
+			auto instance_opt = InstanceSegment::Attach(path);
+			if (instance_opt) {
+				(*instance_opt)->Configure(get_instance_config());
+				return instance_opt;
+			}
+		}
+		return InstanceRegistry::GetInstance()->Get(path);
+	}
+
+	// Options used for building the instance data structures
+	void configure_instance(Instance& instance) const {
+		configure_instance(instance, threads);
+	}
+
+	void configure_instance(Instance& instance, std::size_t threads) const {
+		instance.SetThreadCount(threads);
+	}
+
+	// Neighbourhood order given by --ls-order
+	LocalSearch::Order get_ls_order() const {
+		if (ls_order == "random")
+			return LocalSearch::Order::Random;
+		else if (ls_order == "adaptive")
+			return LocalSearch::Order::Adaptive;
+		else if (ls_order == "bandit")
+			return LocalSearch::Order::Bandit;
+		else
+			return LocalSearch::Order::Fixed;
+	}
+
+	// Descent given by --ls-descent
+	LocalSearch::Descent get_ls_descent() const {
+		if (ls_descent == "best")
+			return LocalSearch::Descent::BestImprovement;
+		else
+			return LocalSearch::Descent::FirstImprovement;
+	}
+
+	// Perturbation given by --perturbation-type
+	LocalSearch::Perturbation get_perturbation() const {
+		if (perturbation_type == "double-bridge")
+			return LocalSearch::Perturbation::DoubleBridge;
+		else if (perturbation_type == "reversal")
+			return LocalSearch::Perturbation::Reversal;
+		else if (perturbation_type == "multi-shift")
+			return LocalSearch::Perturbation::MultiShift;
+		else if (perturbation_type == "bandit")
+			return LocalSearch::Perturbation::Bandit;
+		else
+			return LocalSearch::Perturbation::Moves;
+	}
+
+	// Parses the instance data section
+	bool load_instance(SharedInstance const& instance) const {
+		return load_instance(instance, threads);
+	}
+
+	bool load_instance(SharedInstance const& instance,
+		std::size_t threads) const {
+		configure_instance(*instance, threads);
+		bool was_loaded = instance->IsLoaded();
+		if (!instance->Load())
+			return false;
+		if (shm && !was_loaded) {
+			instance->GetGammaSet(); // published along
+			InstanceSegment::Publish(*instance);
+		}
+		return true;
+	}
+
+	// Instance of the folder, ready to be solved
+	struct prepared_t
+	{
+		enum { Error, Skipped, Loaded } status;
+		std::optional<SharedInstance> instance;
+	};
+
+	// Opens, loads and builds the gamma set of an instance
+	// of the folder (possibly ahead, on another thread),
+	// using 'threads' threads
+	prepared_t prepare_instance(std::string const& path,
+		std::size_t threads) const {
+		auto instance_opt = open_instance(path);
+		if (!instance_opt)
+			return { prepared_t::Error, std::nullopt };
+		auto instance = *instance_opt;
+		if (max_dimension && instance->GetSize() > max_dimension)
+			return { prepared_t::Skipped, instance };
+		if (!load_instance(instance, threads))
+			return { prepared_t::Error, instance };
+		instance->GetGammaSet();
+		return { prepared_t::Loaded, instance };
+	}
+
 	bool stop_ils(IterationStatus const& status) const {
 		if (validate &&
 			!status.solution->IsValid()) {
@@ -140,6 +280,8 @@ struct options_t
 		write_csv_line(status.solution->GetInstance()->GetName(),
 			status.solution->GetCostGap(),
 			status.t);
+		write_stats_lines(status.solution->GetInstance()->GetName(),
+			status.total_stats);
 	}
 
 	void print_gen_status(PopulationStatus const& status) {
@@ -148,11 +290,18 @@ struct options_t
 		write_csv_line(status.best_solution->GetInstance()->GetName(),
 			status.best_solution->GetCostGap(),
 			status.seconds);
+		write_stats_lines(status.best_solution->GetInstance()->GetName(),
+			status.total_stats);
 	}
 
 	bool solve(Solution &solution) {
 		if (heuristic == "ils") {
 			IteratedLocalSearch ils(seed);
+			ils.SetNeighbourhoodOrder(get_ls_order());
+			ils.SetDescent(get_ls_descent(), ls_threads);
+			ils.SetPerturbation(get_perturbation());
+			ils.SetWindowReoptimization(ils_dp_window, ils_dp_period);
+			ils.SetEjectionChains(ls_chain);
 			std::cout << "Starting ILS...\n";
 			auto status = ils.explore(solution,
 				ils_perturbation_factor,
@@ -177,6 +326,10 @@ struct options_t
 			pop->SetMutationChance(gen_mut);
 			pop->SetMutationMin(gen_mut_pmin);
 			pop->SetMutationMax(gen_mut_pmax);
+			pop->SetNeighbourhoodOrder(get_ls_order());
+			pop->SetDescent(get_ls_descent(), ls_threads);
+			pop->SetPerturbation(get_perturbation());
+			pop->SetEjectionChains(ls_chain);
 			auto gen = Genetic(pop);
 			std::cout << "Starting GEN...\n";
 			auto status = gen.explore(
@@ -254,6 +407,24 @@ struct options_t
 			*csvWriter << csv::nc;
 		*csvWriter << time << csv::nl;
 	}
+
+	void write_stats_header() {
+		if (!statsWriter) return;
+		*statsWriter << "Instance" << "Neighbourhood" << "Evaluations"
+			<< "Filter Rejects" << "Applied" << "Gain"
+			<< "Wall Time (s)" << "CPU Time (s)" << csv::nl;
+	}
+
+	// One line per neighbourhood of the local search
+	void write_stats_lines(std::string instanceName,
+		SearchStats const& stats) {
+		if (!statsWriter) return;
+		for (auto const& nbh_stats : stats)
+			*statsWriter << instanceName << nbh_stats.name
+				<< nbh_stats.evaluations << nbh_stats.filter_rejects
+				<< nbh_stats.applied << nbh_stats.gain
+				<< nbh_stats.wall_seconds << nbh_stats.cpu_seconds << csv::nl;
+	}
 };
 
 int main(int argc, char** argv)
@@ -309,9 +480,69 @@ int main(int argc, char** argv)
 			         "perturbation size decreases by ~63%."),
 			arg::def(32))
 
+		.bind("ils-dp-window", &options_t::ils_dp_window,
+			arg::doc("Size of the windows of clients the ILS reorders "
+			         "optimally by dynamic programming (0 = never, at most 12)"))
+
+		.bind("ils-dp-period", &options_t::ils_dp_period,
+			arg::doc("Iterations between window reorderings "
+			         "(0 = only on the best solution, at the end)"))
+
 		.bind("gamma-k", &options_t::gammak,
 			arg::doc("Gamma set size"))
 
+		.bind("gamma-strategy", &options_t::gamma_strategy,
+			arg::doc("Gamma set construction. Available: nearest, grid, "
+			         "quadrant, alpha, alpha-ascent"),
+			arg::def("nearest"))
+
+		.bind("ls-order", &options_t::ls_order,
+			arg::doc("Neighbourhood order of the local search. Available: "
+			         "fixed, random (RVND), adaptive, bandit (UCB1)"),
+			arg::def("fixed"))
+
+		.bind("ls-descent", &options_t::ls_descent,
+			arg::doc("Move applied by the local search. Available: "
+			         "first (improvement), best (improvement)"),
+			arg::def("first"))
+
+		.bind("ls-threads", &options_t::ls_threads,
+			arg::doc("Number of threads evaluating moves with "
+			         "--ls-descent=best (0 = all hardware threads)"),
+			arg::def(0))
+
+		.bind("ls-chain", &options_t::ls_chain,
+			arg::doc("Add ejection chains (variable-depth reversals) "
+			         "as the last neighbourhood of the local search"))
+
+		.bind("perturbation-type", &options_t::perturbation_type,
+			arg::doc("Perturbation of the ILS and of GEN mutations. "
+			         "Available: moves, double-bridge, reversal, multi-shift, "
+			         "bandit (UCB1)"),
+			arg::def("moves"))
+
+		.bind("max-dimension", &options_t::max_dimension,
+			arg::doc("Skip instances of the folder with more nodes than "
+			         "this (0 = no limit)"))
+
+		.bind("no-cache", &options_t::no_cache,
+			arg::doc("Neither read nor write binary instance caches (.tspb)"))
+
+		.bind("prefetch", &options_t::prefetch,
+			arg::doc("Number of instances of the folder prepared ahead, "
+			         "while solving"),
+			arg::def(1))
+
+		.bind("prefetch-threads", &options_t::prefetch_threads,
+			arg::doc("Number of threads used for preparing instances "
+			         "ahead, while solving (0 = all hardware threads)"),
+			arg::def(1))
+
+		.bind("threads", &options_t::threads,
+			arg::doc("Number of threads used for loading instances "
+			         "(0 = all hardware threads)"),
+			arg::def(0))
+
 		.bind("validate", &options_t::validate,
 			arg::doc("Check if solution is valid every iteration"))
 
@@ -355,6 +586,14 @@ int main(int argc, char** argv)
 		.bind("gen-max-seconds", &options_t::gen_max_seconds,
 			arg::doc("Genetic algorithm maximum elapsed time"))
 
+		.bind("shm", &options_t::shm,
+			arg::doc("Share parsed instances with other processes "
+			         "through shared memory segments"))
+
+		.bind("shm-remove", &options_t::shm_remove,
+			arg::doc("Remove the shared memory segments of the "
+			         "instances instead of solving them"))
+
 		.bind("csv-path", &options_t::csvpath,
 			arg::doc("Path to CSV file with results"))
 
@@ -362,7 +601,15 @@ int main(int argc, char** argv)
 			arg::doc("Decimal separator in CSV files"),
 			arg::def(','))
 
+		.bind("stats-path", &options_t::statspath,
+			arg::doc("Path to CSV file with local search statistics, "
+			         "per neighbourhood"))
+
 		.build();
+
+	InstanceCache::SetEnabled(!options.no_cache);
+	InstanceRegistry::GetInstance()->SetDefaultConfig(
+		options.get_instance_config());
 	
 	if (!options.csvpath.empty()) {
 		options.csvWriter = std::make_unique<csv::writer>(
@@ -377,19 +624,37 @@ int main(int argc, char** argv)
 		options.write_csv_header();
 	}
 
+	if (options.ils_dp_window > LocalSearch::max_window_size) {
+		std::cerr << "Windows reordered by dynamic programming can't "
+		             "have more than " << LocalSearch::max_window_size
+		          << " clients (--ils-dp-window).\n";
+		return 1;
+	}
+
+	if (!options.statspath.empty()) {
+		if (!LocalSearch::stats_enabled)
+			std::cerr << "Local search statistics were disabled "
+			             "at compile time (MLP_LS_STATS).\n";
+		options.statsWriter = std::make_unique<csv::writer>(
+			std::string(DATAPATH) + "/" + options.statspath + "/" +
+			std::to_string(options.seed) + "_stats.csv");
+		options.statsWriter->setDecimalSep(options.csvDecimalSeparator);
+		options.write_stats_header();
+	}
+
 	if (!options.ifile.empty()) {
 		std::string ifilepath = std::string(DATAPATH) + "/" + options.ifile;
-		auto iparser = InstanceParser::Open(ifilepath);
+		if (options.shm_remove)
+			return InstanceSegment::Remove(ifilepath) ? 0 : 1;
 		std::cout << "Parsing instance " << options.ifile << "... ";
-		auto instance_opt = iparser->Parse();
-		std::cout << (instance_opt ? "OK" : "ERROR") << std::endl;
-		if (!instance_opt)
+		auto instance_opt = options.open_instance(ifilepath);
+		bool loaded = instance_opt && options.load_instance(*instance_opt);
+		std::cout << (loaded ? "OK" : "ERROR") << std::endl;
+		if (!loaded)
 			return 1;
 		auto instance = *instance_opt;
 		if (options.validate && !instance->IsValid())
 			return 1;
-		if (options.gammak)
-			instance->SetK(options.gammak);
 		Solution solution(instance);
 		options.savefilename = options.ifile + ".sol";
 		options.solve(solution);
@@ -404,34 +669,80 @@ int main(int argc, char** argv)
 		std::cout << (success ? "OK" : "ERROR") << std::endl;
 		if (!success)
 			return 1;
-		if (options.gammak)
-			solution.GetInstance()->SetK(options.gammak);
+		options.configure_instance(*solution.GetInstance());
 		options.savefilename = options.sfile;
 		options.solve(solution);
 	}
 
 	if (!options.ifolder.empty()) {
 		auto sdirpath = std::string(DATAPATH) + "/" + options.ifolder;
+		std::vector<std::string> instance_paths;
 		for (const auto& entry : fs::directory_iterator(sdirpath)) {
 			auto path = entry.path();
 			if (path.extension() != ".tsp")
 				continue; // Accept only tsp instances
-			auto instance_path = path.string();
-			auto iparser = InstanceParser::Open(instance_path);
+			instance_paths.push_back(path.string());
+		}
+
+		if (options.shm_remove) {
+			for (auto const& instance_path : instance_paths)
+				InstanceSegment::Remove(instance_path);
+			return 0;
+		}
+
+		//
+		// The next instances (up to --prefetch of them) are
+		// prepared in the background while solving the current one,
+		// with --prefetch-threads threads so as not to compete with
+		// the solver. The instance awaited right away (nothing being
+		// solved meanwhile) gets --threads threads instead
+		//
+		std::deque<std::future<options_t::prepared_t>> pending;
+		std::size_t next = 0;
+		auto policy = options.prefetch ?
+			std::launch::async : std::launch::deferred;
+
+		for (auto const& instance_path : instance_paths) {
+			while (next < instance_paths.size() &&
+				pending.size() <= options.prefetch)
+				pending.push_back(std::async(policy,
+					&options_t::prepare_instance, &options,
+					instance_paths[next++], pending.empty() ?
+						options.threads : options.prefetch_threads));
+			auto prepared = pending.front().get();
+			pending.pop_front();
+
+			auto path = fs::path(instance_path);
 			std::cout << "Parsing instance " << path.filename() << "... ";
-			auto instance_ptr_opt = iparser->Parse();
-			std::cout << (instance_ptr_opt ? "OK" : "ERROR") << std::endl;
-			if (!instance_ptr_opt) continue; // Ignore errors
-			auto instance_ptr = *instance_ptr_opt;
+			if (prepared.status == options_t::prepared_t::Error) {
+				std::cout << "ERROR" << std::endl;
+				continue; // Ignore errors
+			}
+			auto instance_ptr = *prepared.instance;
+			prepared.instance.reset();
+			if (prepared.status == options_t::prepared_t::Skipped) {
+				std::cout << "SKIPPED (dimension " << instance_ptr->GetSize()
+					<< ")" << std::endl;
+				continue; // Filtered out before parsing data
+			}
+			std::cout << "OK" << std::endl;
 			if (options.validate && !instance_ptr->IsValid())
 				return 1;
-			if (options.gammak)
-				instance_ptr->SetK(options.gammak);
-			Solution solution(instance_ptr);
-			auto instance_filename = fs::path(instance_path).filename();
-			options.savefilename = instance_filename.string() + ".sol";
-			options.solve(solution);
+			options.configure_instance(*instance_ptr);
+			std::weak_ptr<Instance> solved = instance_ptr;
+			{
+				Solution solution(std::move(instance_ptr));
+				options.savefilename = path.filename().string() + ".sol";
+				options.solve(solution);
+			}
 			std::cout << std::endl;
+
+			//
+			// Once solved (and saved), the instance is released, so
+			// that only the ones prefetched stay in memory
+			//
+			InstanceRegistry::GetInstance()->Remove(instance_path);
+			assert(solved.expired());
 		}
 	}
 	return 0;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "instance.h"
+
+// Binary cache of a parsed instance, next to its source file
+// (e.g. pa561.tspb for pa561.tsp), holding an instance image
+// (see image.h). The cache is only valid for the contents of
+// the source file it was written from.
+class InstanceCache
+{
+public:
+	// Cache file path for a given instance file
+	static std::string GetPath(std::string const& filename);
+
+	// Stamp identifying the contents of a source file
+	static std::uint64_t GetStamp(std::string_view contents);
+
+	// Maps the cache read-only, if it matches 'stamp'
+	static std::optional<std::shared_ptr<Instance>> Read(
+		std::string const& filename, std::uint64_t stamp);
+
+	// Writes the cache of a loaded instance
+	static bool Write(Instance const& instance, std::uint64_t stamp);
+
+	// Whether instance parsers use (and write) caches
+	// (they do by default)
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+};
\ No newline at end of file
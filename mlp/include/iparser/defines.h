@@ -1,4 +1,10 @@
-#pragma
+#pragma once
+
+#include <cstddef>
+
 using Node = std::size_t;
 using Pos = double;
-using Dist = int;
\ No newline at end of file
+using Dist = int;
+
+// Gamma set size used until another one is set
+constexpr std::size_t DEFAULT_GAMMA_K = 50;
\ No newline at end of file
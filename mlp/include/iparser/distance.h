@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "defines.h"
+#include "ds.h"
+
+// Distance functions of TSPLIB (EDGE_WEIGHT_TYPE)
+enum class EdgeWeightType
+{
+	Explicit,    // EXPLICIT
+	Euclidean,   // EUC_2D
+	Ceiling,     // CEIL_2D
+	Geographic,  // GEO
+	Pseudo,      // ATT
+	Manhattan,   // MAN_2D
+};
+
+std::optional<EdgeWeightType> GetEdgeWeightType(std::string const& name);
+
+// Distance matrix between the nodes at 'coords' (n x 2),
+// computed by blocks of rows on 'threads' threads
+std::shared_ptr<ds::SquareMatrix<Dist>> ComputeDistanceMatrix(
+	EdgeWeightType type, ds::Matrix<Pos> const& coords, std::size_t threads);
\ No newline at end of file
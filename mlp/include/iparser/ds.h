@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cassert>
 #include <memory>
@@ -11,23 +12,33 @@
 namespace ds
 {
 	template<typename T>
-	T** constructs2dMatrix(std::size_t m, std::size_t n)
+	std::shared_ptr<T> constructsContiguousBlock(std::size_t size)
 	{
-		assert(m > 0);
-		assert(n > 0);
-		T** matrix = new T*[m];
-		while (m--) matrix[m] = new T[n];
-		return matrix;
+		assert(size > 0);
+		return std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
 	}
 
+	// Read-only view over contiguous elements
 	template<typename T>
-	void destroy2dMatrix(T** matrix, std::size_t m)
+	class Span
 	{
-		if (!matrix)
-			return;
-		while (m--) delete[] matrix[m];
-		delete[] matrix;
-	}
+	public:
+		Span(T const* first, std::size_t count) :
+			first(first), count(count) {}
+		T const* begin() const { return first; }
+		T const* end() const { return first + count; }
+		T const& operator[](std::size_t i) const { return first[i]; }
+		std::size_t size() const { return count; }
+		bool operator==(Span const& other) const
+		{
+			return count == other.count &&
+				std::equal(first, first + count, other.first);
+		}
+		bool operator!=(Span const& other) const { return !(*this == other); }
+	private:
+		T const* first;
+		std::size_t count;
+	};
 
 	template<typename T>
 	class Matrix
@@ -37,16 +48,30 @@ namespace ds
 		{
 			return std::shared_ptr<Matrix<T>>(new Matrix<T>(m, n));
 		}
-		T* operator[](std::size_t i) { return matrix[i]; }
-		T const* operator[] (std::size_t i) const { return matrix[i]; }
+		// Read-only matrix over memory kept alive by 'owner'
+		// (e.g. a segment mapped read-only)
+		static std::shared_ptr<Matrix<T> const> Wrap(T const* data,
+			std::size_t m, std::size_t n, std::shared_ptr<void const> owner)
+		{
+			return std::shared_ptr<Matrix<T> const>(
+				new Matrix<T>(const_cast<T*>(data), m, n, owner));
+		}
+		T* operator[](std::size_t i) { return matrix + i * n; }
+		T const* operator[] (std::size_t i) const { return matrix + i * n; }
+		T const* data() const { return matrix; }
 		std::size_t getm() const { return m; }
 		std::size_t getn() const { return n; }
-		~Matrix() { destroy2dMatrix(matrix, m); }
 	protected:
 		Matrix(std::size_t m, std::size_t n) :
-			m(m), n(n), matrix(constructs2dMatrix<T>(m, n)) {}
+			Matrix(constructsContiguousBlock<T>(m * n), m, n) {}
+		Matrix(std::shared_ptr<T> block, std::size_t m, std::size_t n) :
+			Matrix(block.get(), m, n, block) {}
+		Matrix(T* data, std::size_t m, std::size_t n,
+			std::shared_ptr<void const> owner) :
+			block(owner), matrix(data), m(m), n(n) {}
 	private:
-		T** matrix;
+		std::shared_ptr<void const> block;
+		T* matrix;
 		std::size_t m;
 		std::size_t n;
 	};
@@ -59,9 +84,17 @@ namespace ds
 		{
 			return std::shared_ptr<SquareMatrix<T>>(new SquareMatrix<T>(n));
 		}
-		std::size_t size() const { return getm(); }
+		static std::shared_ptr<SquareMatrix<T> const> Wrap(T const* data,
+			std::size_t n, std::shared_ptr<void const> owner)
+		{
+			return std::shared_ptr<SquareMatrix<T> const>(
+				new SquareMatrix<T>(const_cast<T*>(data), n, owner));
+		}
+		std::size_t size() const { return this->getm(); }
 	protected:
 		SquareMatrix(std::size_t n) :
-			Matrix(n, n) {}
+			Matrix<T>(n, n) {}
+		SquareMatrix(T* data, std::size_t n, std::shared_ptr<void const> owner) :
+			Matrix<T>(data, n, n, owner) {}
 	};
-}
+}
\ No newline at end of file
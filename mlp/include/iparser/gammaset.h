@@ -1,10 +1,12 @@
 #pragma once
 
 #include <cstddef>
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "defines.h"
+#include "ds.h"
 
 class Instance;
 
@@ -12,12 +14,70 @@ namespace ds
 {
 	class GammaSet
 	{
+	public:
+		enum class Strategy
+		{
+			Nearest,  // k nearest neighbours, scanning all the nodes
+			Grid,     // k nearest neighbours, through a spatial grid
+			Quadrant, // nearest neighbours of each quadrant, then nearest
+			Alpha,    // alpha-nearest neighbours in the minimum 1-tree
+			AlphaAscent, // same, with subgradient optimized penalties
+		};
 	private:
+		std::size_t n;
 		std::size_t k;
-		std::map<Node, std::vector<Node>> map;
+		std::size_t stride; // nodes stored per row (k <= stride)
+		std::shared_ptr<void const> block;
+		Node const* rows; // n rows of 'stride' nodes each
+
+		//
+		// Reverse lists (compressed rows) and n x n membership
+		// bitset of the first k nodes of every row
+		//
+		struct adjacency_t
+		{
+			std::size_t words; // per bitset row
+			std::vector<std::uint64_t> bits;
+			std::vector<std::size_t> start;
+			std::vector<Node> nodes;
+		};
+		std::shared_ptr<adjacency_t const> adjacency;
 	public:
-		GammaSet(Instance const& instance, std::size_t k);
-		std::vector<Node> const& getClosestNeighbours(Node node) const;
+		// Of a loaded instance (see Instance::Load)
+		GammaSet(Instance const& instance, std::size_t k,
+			std::size_t threads = 1, Strategy strategy = Strategy::Nearest);
+		// Gamma set over rows kept alive by 'owner'
+		GammaSet(Node const* rows, std::size_t n, std::size_t k,
+			std::shared_ptr<void const> owner);
+		// Gamma set of the k closest neighbours, sharing the rows
+		GammaSet View(std::size_t k) const;
+		Span<Node> getClosestNeighbours(Node node) const
+		{
+			return Span<Node>(rows + node * stride, k);
+		}
+		// Nodes having 'node' in their gamma set, in increasing order
+		Span<Node> getReverseNeighbours(Node node) const
+		{
+			auto const& a = *adjacency;
+			return Span<Node>(a.nodes.data() + a.start[node],
+				a.start[node + 1] - a.start[node]);
+		}
+		// Whether j is in the gamma set of i
+		bool isCandidate(Node i, Node j) const
+		{
+			auto const& a = *adjacency;
+			return (a.bits[i * a.words + j / 64] >> (j % 64)) & 1;
+		}
+		Node const* data() const { return rows; }
 		std::size_t getK() const { return k; }
+		std::size_t getMaxK() const { return stride; }
+	private:
+		void buildNearest(Instance const& instance, Node* matrix,
+			std::size_t threads);
+		void buildFromGrid(Instance const& instance, Node* matrix,
+			std::size_t threads, bool quadrants);
+		void buildAlpha(Instance const& instance, Node* matrix,
+			std::size_t threads, bool ascent);
+		void buildAdjacency();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "instance.h"
+
+// Flat image of a parsed instance, which can be placed in
+// any memory region (e.g. a shared memory segment) and be
+// read back without parsing nor copying the matrices.
+class InstanceImage
+{
+public:
+	// Number of bytes needed to store the instance image, with
+	// its gamma set if already built (it is not built for it)
+	static std::size_t GetSize(Instance const& instance);
+
+	// Writes image to 'buffer', of 'size' (see GetSize) bytes
+	// 'stamp' identifies the version of the source file
+	// Fails if the gamma set has grown since GetSize
+	static bool Write(Instance const& instance, std::uint64_t stamp,
+		void* buffer, std::size_t size);
+
+	// Stamp identifying the current version of a file
+	// (by its size and last modification time)
+	static std::optional<std::uint64_t> GetFileStamp(
+		std::string const& filename);
+
+	// Stamp of a valid image, or std::nullopt if ill-formed
+	static std::optional<std::uint64_t> GetStamp(void const* buffer,
+		std::size_t size);
+
+	// Instance whose matrices point to 'buffer'
+	// 'owner' must keep 'buffer' valid for as long as the
+	// instance (or any of its matrices) is alive.
+	static std::optional<std::shared_ptr<Instance>> Read(void const* buffer,
+		std::size_t size, std::shared_ptr<void const> owner);
+};
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
+#include <tuple>
 
 #include "ds.h"
 #include "defines.h"
@@ -9,27 +14,93 @@
 class Instance
 {
 public:
+	// Options the gamma sets of the instance are built with
+	struct Config
+	{
+		ds::GammaSet::Strategy strategy = ds::GammaSet::Strategy::Nearest;
+		std::size_t k = DEFAULT_GAMMA_K;
+
+		bool operator< (Config const& other) const
+		{
+			return std::tie(strategy, k) < std::tie(other.strategy, other.k);
+		}
+	};
+
 	std::string const& GetName () const { return name; }
 	std::string const& GetComment () const { return comment; }
 	std::string const& GetSourceFilePath() const { return filepath; }
-	ds::SquareMatrix<Dist> const& GetDistanceMatrix () const { return *dmatrix; }
-	std::size_t GetSize () const { return dmatrix->getm(); }
+	ds::SquareMatrix<Dist> const& GetDistanceMatrix () const { EnsureLoaded(); return *dmatrix; }
+	std::size_t GetSize () const { return dimension; }
+	// Only once loaded (see Load), since it is
+	// in the innermost loops of the local search
 	Dist const* operator[] (Node i) const { return (*dmatrix)[i]; }
-	std::shared_ptr<ds::Matrix<Pos> const> GetPositionMatrix() const { return posmatrix; }
-	void SetK(std::size_t k) { gammaset = std::make_shared<ds::GammaSet>(*this, k); }
-	std::shared_ptr<ds::GammaSet const> GetGammaSet() const { return gammaset; }
+	std::shared_ptr<ds::Matrix<Pos> const> GetPositionMatrix() const { EnsureLoaded(); return posmatrix; }
+	// The gamma set options of an instance shared through the
+	// InstanceRegistry are fixed (see IsShared), and these
+	// setters leave them unchanged
+	void SetK(std::size_t k);
+	// Gamma sets up to this size are views of the same rows
+	void SetMaxK(std::size_t k);
+	void SetGammaStrategy(ds::GammaSet::Strategy strategy);
+	// Sets the strategy and k at once, without loading the
+	// instance (the gamma set is built on its first access)
+	void Configure(Config const& config);
+	Config GetConfig() const;
+	bool IsShared() const { return shared; }
+	// Only changes how fast data structures are built,
+	// so it may be set on shared instances too
+	void SetThreadCount(std::size_t threads) { this->threads.store(threads); }
+	std::size_t GetThreadCount() const { return threads.load(); }
+	// Whether distances are within one unit of the euclidean
+	// distance between the node positions
+	bool HasConsistentCoordinates() const;
+	std::shared_ptr<ds::GammaSet const> GetGammaSet() const;
+	std::shared_ptr<ds::GammaSet const> GetGammaSet(std::size_t k) const;
+	// Whether the gamma set is already built (or was read
+	// along the instance, see InstanceImage)
+	bool HasGammaSet() const;
+
+	// Data section (distances, positions) is parsed on demand
+	bool Load() const;
+	void Prefetch() const;
+	bool IsLoaded() const { return loaded.load(std::memory_order_acquire); }
 	
 	// for debugging purposes
 	bool IsValid() const;
 private:
 	Instance() = default;
+	void EnsureLoaded() const { if (!IsLoaded()) Load(); }
+	bool RunLoader();
+	ds::GammaSet const& GetOrdering(std::size_t k) const;
+	bool isFixed(bool changed) const;
 private:
 	std::string name;
 	std::string comment;
 	std::string filepath;
-	std::shared_ptr<ds::GammaSet> gammaset;
-	std::shared_ptr<ds::SquareMatrix<Dist>> dmatrix;
-	std::shared_ptr<ds::Matrix<Pos>> posmatrix;
+	std::size_t dimension = 0;
+	// used for building data structures, possibly read by
+	// the loader thread (see Prefetch) while being set
+	std::atomic<std::size_t> threads { 1 };
+	bool shared = false; // see InstanceRegistry
+	ds::GammaSet::Strategy strategy = ds::GammaSet::Strategy::Nearest;
+	std::size_t gamma_k = DEFAULT_GAMMA_K;
+	std::size_t gamma_max_k = DEFAULT_GAMMA_K;
+	mutable std::shared_ptr<ds::GammaSet const> ordering; // up to gamma_max_k
+	mutable std::shared_ptr<ds::GammaSet const> gammaset; // view of gamma_k
+	std::shared_ptr<ds::SquareMatrix<Dist> const> dmatrix;
+	std::shared_ptr<ds::Matrix<Pos> const> posmatrix;
+
+	std::function<bool(Instance&)> loader;
+	// once, after GetGammaSet first returns a gamma set
+	std::function<void(Instance const&)> on_gammaset;
+	mutable std::once_flag on_gammaset_flag;
+	mutable std::atomic<bool> loaded { false };
+	mutable std::mutex load_mutex;
+	mutable std::mutex gammaset_mutex;
+	mutable std::shared_future<bool> payload; // must be destroyed first
 
 	friend class InstanceParser;
-};
+	friend class InstanceImage;
+	friend class InstanceCache;
+	friend class InstanceRegistry;
+};
\ No newline at end of file
@@ -1,5 +1,4 @@
 #pragma once
-#include <fstream>
 #include <map>
 #include <memory>
 #include <optional>
@@ -9,6 +8,7 @@
 
 #include "defines.h"
 #include "instance.h"
+#include "tokenizer.h"
 
 using SharedInstance = std::shared_ptr<Instance>;
 using SharedInstanceParser = std::shared_ptr<InstanceParser>;
@@ -17,19 +17,28 @@ using MapEntry = std::pair<std::string, std::string>;
 
 class IDistanceMatrixBuilder;
 
-class InstanceParser
+class InstanceParser : public std::enable_shared_from_this<InstanceParser>
 {
 public:
 	static SharedInstanceParser Open(std::string const& filename);
 	std::optional<SharedInstance> Parse();
+	std::optional<SharedInstance> ParseSpecification();
+
+	// Minimum number of distances decoded by each thread
+	// when parsing an EDGE_WEIGHT_SECTION in parallel
+	static void SetChunkSize(std::size_t entries);
 private:
 	InstanceParser(std::string const& filename);
 
-	bool ParseSpecification(SharedInstance& instance, MapEntry entry);
-	bool ParseData(SharedInstance& instance, std::string key);
+	bool ParseSpecificationEntry(Instance& instance, MapEntry entry);
+	bool ParseDataSections(Instance& instance);
+	bool ParseData(Instance& instance, std::string key);
 
-	bool ParseDisplayData(SharedInstance& instance);
-	bool ParseEdgeWeights(SharedInstance& instance);
+	bool ParseNodeCoords(Instance& instance);
+	bool ParseDisplayData(Instance& instance);
+	std::shared_ptr<ds::Matrix<Pos>> ReadPositions(std::size_t n,
+		std::string const& section);
+	bool ParseEdgeWeights(Instance& instance);
 
 	template<typename T>
 	std::optional<T> GetEntryValue(std::string key) {
@@ -43,7 +52,9 @@ private:
 		}
 	}
 private:
-	std::ifstream fs;
+	std::shared_ptr<FileBuffer const> file;
+	Tokenizer tokens;
 	std::string filename;
+	std::size_t data_offset = 0;
 	std::map<std::string, VarMapValueType> entry_map;
 };
\ No newline at end of file
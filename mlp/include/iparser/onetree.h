@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "defines.h"
+
+class Instance;
+
+namespace ds
+{
+	//
+	// Minimum 1-tree: a minimum spanning tree over every node
+	// but a special one, plus the two cheapest edges of the
+	// special node, under the costs d(i, j) + pi[i] + pi[j]
+	// (of a loaded instance, see Instance::Load)
+	//
+	class OneTree
+	{
+	public:
+		OneTree(Instance const& instance, std::vector<double> pi = {});
+
+		// Node penalties maximizing the lower bound
+		// (subgradient optimization, as in LKH)
+		static std::vector<double> Ascent(Instance const& instance);
+
+		double getCost(Node i, Node j) const;
+		// Lower bound on the length of any tour
+		double getLowerBound() const { return lower_bound; }
+		bool isTour() const;
+
+		// Alpha-nearness of every node to node i: how much the
+		// minimum 1-tree grows when forced to contain (i, j).
+		// 'beta' and 'mark' are scratch buffers of size n.
+		void computeAlphas(Node i, std::vector<double>& alphas,
+			std::vector<double>& beta, std::vector<Node>& mark) const;
+	private:
+		Instance const* instance;
+		std::size_t n;
+		std::vector<double> pi;
+		std::vector<Node> order; // tree nodes, parents first
+		std::vector<Node> dad;
+		std::vector<int> degree;
+		Node special;
+		Node first, second; // neighbours of the special node
+		double lower_bound;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "instance.h"
+
+// Process-wide cache of parsed instances, so that every
+// solution, solver or plotter referring to the same instance
+// file shares a single Instance object.
+// Entries are keyed by the canonical path of the file and the
+// gamma set options of the instance, which can't be changed
+// afterwards (see Instance::IsShared), and are discarded once
+// the file is modified.
+// The registry does not own the instances: they are shared while
+// some user holds them, and parsed again once they are released.
+class InstanceRegistry
+{
+public:
+	static std::shared_ptr<InstanceRegistry> GetInstance();
+
+	// Shared instance parsed from 'filename' (see ParseSpecification),
+	// with the given gamma set options, or the default ones
+	std::optional<std::shared_ptr<Instance>> Get(std::string const& filename);
+	std::optional<std::shared_ptr<Instance>> Get(std::string const& filename,
+		Instance::Config const& config);
+
+	// Options of the instances asked for without any
+	// (e.g. by deserialized solutions)
+	void SetDefaultConfig(Instance::Config const& config);
+
+	// Forgets about instances (which are still alive while in use)
+	void Remove(std::string const& filename);
+	void Clear();
+private:
+	InstanceRegistry() = default;
+private:
+	struct entry_t
+	{
+		std::uint64_t stamp;
+		std::weak_ptr<Instance> instance;
+	};
+	std::mutex mutex;
+	Instance::Config default_config;
+	std::map<std::pair<std::string, Instance::Config>, entry_t> entries;
+	static std::shared_ptr<InstanceRegistry> instance;
+};
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "instance.h"
+
+// Named shared memory segment holding an instance image
+// (see image.h), shared between processes of the same host.
+// The segment is named after the canonical path of the
+// instance file, and is only valid for the version of the
+// file it was published from.
+class InstanceSegment
+{
+public:
+	// Maps the segment read-only, if published and up to date
+	// (an abandoned or outdated segment is removed instead)
+	static std::optional<std::shared_ptr<Instance>> Attach(
+		std::string const& filename);
+
+	// Creates the segment from a parsed instance
+	// Fails if it already exists, unless abandoned by a
+	// publisher that died before it was ready
+	static bool Publish(Instance const& instance);
+
+	// Unlinks the segment (processes attached keep their mapping)
+	static bool Remove(std::string const& filename);
+
+	// Segment name for a given instance file
+	static std::optional<std::string> GetName(std::string const& filename);
+};
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Whole contents of a file, memory mapped where supported
+// (read into memory otherwise)
+class FileBuffer
+{
+public:
+	static std::shared_ptr<FileBuffer const> Open(std::string const& filename);
+	~FileBuffer();
+	std::string_view View() const { return std::string_view(data, size); }
+private:
+	FileBuffer() = default;
+	FileBuffer(FileBuffer const&) = delete;
+	FileBuffer& operator=(FileBuffer const&) = delete;
+private:
+	char const* data = nullptr;
+	std::size_t size = 0;
+	bool mapped = false;
+	std::string contents; // when not mapped
+};
+
+// Reads lines and numbers out of a buffer
+class Tokenizer
+{
+public:
+	Tokenizer(std::string_view buffer, std::size_t offset = 0) :
+		buffer(buffer), offset(offset) {}
+
+	// Next non-blank line, without trailing whitespace
+	// (false if end of buffer)
+	bool NextLine(std::string_view& line);
+
+	// Next number, skipping whitespace (and line breaks)
+	template<typename T>
+	bool Next(T& value)
+	{
+		SkipWhitespace();
+		auto first = buffer.data() + offset;
+		auto last = buffer.data() + buffer.size();
+		if (first != last && *first == '+')
+			++first;
+		auto [ptr, ec] = std::from_chars(first, last, value);
+		if (ec != std::errc())
+			return false;
+		offset = ptr - buffer.data();
+		return true;
+	}
+
+	// Number of whitespace separated tokens
+	static std::size_t CountTokens(std::string_view buffer);
+
+	std::string_view GetBuffer() const { return buffer; }
+	std::size_t GetOffset() const { return offset; }
+	void Seek(std::size_t offset) { this->offset = offset; }
+private:
+	void SkipWhitespace();
+private:
+	std::string_view buffer;
+	std::size_t offset;
+};
\ No newline at end of file
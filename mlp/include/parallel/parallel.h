@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel
+{
+	// Actual number of threads for a requested count
+	// (0 = as many as the hardware supports)
+	std::size_t GetThreadCount(std::size_t threads);
+
+	// Calls f(begin, end) for disjoint blocks covering [0, n),
+	// each one on its own thread, and waits for all of them
+	void ForBlocks(std::size_t n, std::size_t threads,
+		std::function<void(std::size_t, std::size_t)> const& f);
+
+	// Threads kept alive between calls, for work split
+	// too often for spawning threads each time to pay off
+	class ThreadPool
+	{
+	public:
+		ThreadPool(std::size_t threads = 0);
+		~ThreadPool();
+		ThreadPool(ThreadPool const&) = delete;
+		ThreadPool& operator=(ThreadPool const&) = delete;
+
+		// Number of threads, counting the calling one
+		std::size_t GetThreadCount() const;
+
+		// Same as parallel::ForBlocks, on the threads of the pool
+		// (must not be called by two threads at once)
+		void ForBlocks(std::size_t n,
+			std::function<void(std::size_t, std::size_t)> const& f);
+	private:
+		void work(std::size_t id);
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		std::function<void(std::size_t, std::size_t)> const* task = nullptr;
+		std::size_t task_n = 0, task_blocks = 0;
+		std::size_t generation = 0, pending = 0;
+		bool stopping = false;
+	};
+}
\ No newline at end of file
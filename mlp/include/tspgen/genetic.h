@@ -4,6 +4,7 @@
 #include <functional>
 
 #include "population.h"
+#include "stats.h"
 
 struct PopulationStatus
 {
@@ -13,6 +14,10 @@ struct PopulationStatus
 	std::size_t generations = 0;
 	unsigned long long seconds = 0;
 	std::shared_ptr<Solution> best_solution;
+	// Local search counters of the last generation,
+	// and of the whole search (see stats.h)
+	SearchStats generation_stats;
+	SearchStats total_stats;
 };
 
 class Genetic
@@ -5,8 +5,11 @@
 #include <random>
 #include <map>
 #include <memory>
+#include <memory_resource>
 
 #include "solution.h"
+#include "ls.h"
+#include "stats.h"
 
 class Population : public std::vector<std::shared_ptr<Solution>>
 {
@@ -24,6 +27,11 @@ public:
 	void SetMutationMin(double min);
 	void SetMutationMax(double max);
 	void SetMutationChance(double chance);
+	void SetNeighbourhoodOrder(LocalSearch::Order order);
+	void SetDescent(LocalSearch::Descent descent, std::size_t threads = 1);
+	void SetPerturbation(LocalSearch::Perturbation perturbation);
+	// Adds ejection chains to the local search (see ChainPipeline)
+	void SetEjectionChains(bool enabled);
 
 	void SetVerbosity(bool isVerbose);
 	bool GetVerbosity() const;
@@ -33,11 +41,27 @@ public:
 	Cost GetSolutionCost (std::shared_ptr<Solution> const& sol) const;
 	Cost GetAverageCost () const;
 	std::shared_ptr<Solution> GetBestSolution () const;
+	// Local search counters of the last generation (see stats.h)
+	SearchStats const& GetGenerationStats () const;
 private:
+	template<class Search>
+	void mutate(Solution& offspring, std::size_t perturbationSize);
+private:
+	// Pool of the solutions of the population (and their offspring),
+	// and pool the scratch memory of each generation comes from
+	std::shared_ptr<std::pmr::memory_resource> solution_pool;
+	std::shared_ptr<std::pmr::memory_resource> scratch_pool;
 	std::shared_ptr<Instance> instance_ptr;
 	std::map<std::shared_ptr<Solution>, Cost> cost_map;
 	std::size_t minSize, maxSize, matingPoolSize, generationCount;
 	std::default_random_engine rng;
 	double mutation_min, mutation_max, mutation_chance;
+	LocalSearch::Order ls_order = LocalSearch::Order::Fixed;
+	LocalSearch::Descent ls_descent = LocalSearch::Descent::FirstImprovement;
+	std::shared_ptr<parallel::ThreadPool> ls_pool;
+	LocalSearch::Perturbation ls_perturbation = LocalSearch::Perturbation::Moves;
+	bool ls_chains = false;
+	std::shared_ptr<LocalSearch::PerturbationBandit> perturbation_bandit;
+	SearchStats generation_stats;
 	bool verbose;
 };
\ No newline at end of file
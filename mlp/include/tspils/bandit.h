@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// UCB1 policy over 'N' arms (e.g. neighbourhoods)
+//
+// Each pull of an arm is rewarded by the cost decrease it led
+// to, over the effort it took (e.g. moves evaluated). The mean
+// rewards are scaled by the best one, so that the exploration
+// term keeps its weight whatever the instance costs. Only the
+// recent history counts, since the best arm changes over time.
+template<std::size_t N>
+class Bandit
+{
+public:
+	static constexpr std::size_t size = N;
+
+	void Reward(std::size_t arm, double gain, double effort)
+	{
+		gains[arm] += gain;
+		efforts[arm] += effort;
+		pulls[arm] += 1;
+		total_pulls += 1;
+		if (total_pulls > window) {
+			for (std::size_t a = 0; a < N; ++a) {
+				gains[a] /= 2;
+				efforts[a] /= 2;
+				pulls[a] /= 2;
+			}
+			total_pulls /= 2;
+		}
+	}
+
+	// Upper confidence bound of every arm (infinite if never pulled)
+	std::array<double, N> Scores() const
+	{
+		std::array<double, N> means, scores;
+		for (std::size_t a = 0; a < N; ++a)
+			means[a] = gains[a] / (efforts[a] + 1);
+		auto best_mean = *std::max_element(means.begin(), means.end());
+		for (std::size_t a = 0; a < N; ++a) {
+			if (pulls[a] < 1) {
+				scores[a] = std::numeric_limits<double>::infinity();
+				continue;
+			}
+			auto mean = best_mean > 0 ? means[a] / best_mean : 0;
+			scores[a] = mean + exploration *
+				std::sqrt(std::log(total_pulls) / pulls[a]);
+		}
+		return scores;
+	}
+
+	// Arm of the highest bound (the first one, on ties)
+	std::size_t Select() const
+	{
+		auto scores = Scores();
+		return std::max_element(scores.begin(), scores.end()) - scores.begin();
+	}
+
+	void Reset()
+	{
+		*this = Bandit();
+	}
+private:
+	static constexpr double exploration = 1.4142135623730951; // sqrt(2)
+	static constexpr double window = 1 << 16;
+	std::array<double, N> gains {};
+	std::array<double, N> efforts {};
+	std::array<double, N> pulls {};
+	double total_pulls = 0;
+};
\ No newline at end of file
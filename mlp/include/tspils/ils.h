@@ -5,6 +5,8 @@
 #include <memory>
 
 #include "solution.h"
+#include "ls.h"
+#include "stats.h"
 
 // Current iteration status
 struct IterationStatus
@@ -14,6 +16,10 @@ struct IterationStatus
 	std::size_t perturbationSize = 0;
 	unsigned long long t_last_improvement = 0;
 	unsigned long long t = 0;
+	// Local search counters of the last iteration,
+	// and of the whole search (see stats.h)
+	SearchStats iteration_stats;
+	SearchStats total_stats;
 };
 
 class IteratedLocalSearch
@@ -39,6 +45,42 @@ public:
 		seed(seed)
 	{}
 
+	// Neighbourhood order of the local search (see ls.h)
+	void SetNeighbourhoodOrder (LocalSearch::Order order)
+	{
+		this->order = order;
+	}
+
+	// Descent of the local search, and the number of threads
+	// evaluating its moves in best-improvement (0 = all of them)
+	void SetDescent (LocalSearch::Descent descent, std::size_t threads = 1)
+	{
+		this->descent = descent;
+		this->threads = threads;
+	}
+
+	// Perturbation operator between descents (see ls.h)
+	void SetPerturbation (LocalSearch::Perturbation perturbation)
+	{
+		this->perturbation_type = perturbation;
+	}
+
+	// Reorders windows of 'window_size' clients optimally (see
+	// LocalSearch::reoptimizeWindows) every 'period' iterations,
+	// or only on the best solution at the end, if 'period' is 0
+	// (a 'window_size' of 0, the default, never does)
+	void SetWindowReoptimization (std::size_t window_size, std::size_t period = 0)
+	{
+		this->window_size = window_size;
+		this->window_period = period;
+	}
+
+	// Adds ejection chains to the local search (see ChainPipeline)
+	void SetEjectionChains (bool enabled)
+	{
+		this->ejection_chains = enabled;
+	}
+
 	// Starts with 'initial_solution'
 	// Pertubation of magnitude of 'pertubation'
 	// Stops when 'stopping_criterion()' is true
@@ -46,6 +88,19 @@ public:
 		                                  double perturbation,
 		                                  unsigned long long ils_decay_factor,
 		                                  StoppingCriterion stopping_criterion);
+private:
+	// explore, with a local search of type 'Search'
+	template<class Search>
+	IterationStatus search(Solution const& initial_solution,
+		double perturbation, unsigned long long ils_decay_factor,
+		StoppingCriterion stopping_criterion);
 private:
 	unsigned int seed;
+	LocalSearch::Order order = LocalSearch::Order::Fixed;
+	LocalSearch::Descent descent = LocalSearch::Descent::FirstImprovement;
+	std::size_t threads = 1;
+	LocalSearch::Perturbation perturbation_type = LocalSearch::Perturbation::Moves;
+	std::size_t window_size = 0;
+	std::size_t window_period = 0;
+	bool ejection_chains = false;
 };
\ No newline at end of file
@@ -1,17 +1,539 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
 
+#include "bandit.h"
+#include "parallel.h"
+#include "pipeline.h"
 #include "solution.h"
+#include "stats.h"
 
-class LocalSearch
+// Part of the local search that does not depend
+// on its neighbourhoods (see BasicLocalSearch)
+class LocalSearchBase
 {
 public:
-	LocalSearch(std::default_random_engine& rng);
-	LocalSearch(unsigned int seed);
-	int findLocalMinimum(Solution& solution);
-	void perturbSolution(Solution& solution, std::size_t pertubationSize);
+	// Order in which the neighbourhoods are tried
+	// - Fixed: as listed in the pipeline
+	// - Random: reshuffled on every restart (RVND)
+	// - Adaptive: by recent improvements per evaluation
+	// - Bandit: by UCB1 bound of cost decrease per evaluation
+	enum class Order { Fixed, Random, Adaptive, Bandit };
+
+	// Move applied on each step of the descent
+	// - FirstImprovement: the first improving one found
+	// - BestImprovement: the best one among all the candidates
+	//   of a neighbourhood, evaluated on the pool (if given)
+	enum class Descent { FirstImprovement, BestImprovement };
+
+	// How perturbSolution changes a solution
+	// - Moves: random moves between gamma set neighbours
+	// - DoubleBridge: exchanges two adjacent random segments
+	// - Reversal: reverses a random segment
+	// - MultiShift: moves random nodes within a random segment
+	// - Bandit: one of the above, by UCB1 (see RewardPerturbation)
+	// All but Moves only touch a segment as long as the
+	// perturbation size (twice as long, for MultiShift)
+	enum class Perturbation { Moves, DoubleBridge, Reversal, MultiShift, Bandit };
+	using PerturbationBandit = Bandit<4>;
+
+	// Whether neighbourhood statistics are collected (see stats.h)
+	static constexpr bool stats_enabled = MLP_LS_STATS;
+
+	LocalSearchBase(std::default_random_engine& rng);
+	LocalSearchBase(unsigned int seed);
+	// Memory of the buffers used by each call, which are taken from
+	// an arena over this resource (by default, a pool of its own)
+	// and given back to it on return. Not shared among threads.
+	void SetScratchResource(std::shared_ptr<std::pmr::memory_resource> scratch);
+	void SetPerturbation(Perturbation perturbation);
+	// Policy choosing the perturbation with Perturbation::Bandit,
+	// which may be shared by many local searches (e.g. mutations)
+	void SetPerturbationBandit(std::shared_ptr<PerturbationBandit> bandit);
+	// Appends the clients it touches to 'touched_nodes', if given
+	void perturbSolution(Solution& solution, std::size_t pertubationSize,
+		std::vector<Node>* touched_nodes = nullptr);
+	// Rewards the last perturbation chosen by the bandit with the
+	// cost decrease of the solution since, over the moves evaluated
+	// by the descents since
+	void RewardPerturbation(Cost gain);
+	// Reorders every window of 'window_size' consecutive clients
+	// optimally (by dynamic programming over subsets, so up to
+	// max_window_size), appending the clients of the improved
+	// windows to 'touched_nodes', if given. Returns how many were.
+	int reoptimizeWindows(Solution& solution, std::size_t window_size,
+		std::vector<Node>* touched_nodes = nullptr);
+	// (its tables take 2^w.w entries, so w = 12 already needs ~0.5 MB)
+	static constexpr std::size_t max_window_size = 12;
 private:
+	void perturbSegment(Solution& solution, std::size_t pertubationSize,
+		Perturbation perturbation, std::vector<Node>* touched_nodes);
+protected:
+	// Move evaluated by the best-improvement descent
+	struct move_t
+	{
+		// Ties are broken by nodes, for the same
+		// result whatever the number of threads
+		friend bool operator<(move_t const& a, move_t const& b)
+		{
+			return std::tie(a.delta, a.ni, a.nj, a.nr) <
+			       std::tie(b.delta, b.ni, b.nj, b.nr);
+		}
+
+		Cost delta = 0;
+		Node ni = 0, nj = 0, nr = 0;
+	};
+
+	// Visits every client whose tour neighbourhood may have been
+	// changed by the last move, which rearranged the positions
+	// between 'lb' and 'ub' and carried the 'moved' nodes along
+	// ('whole_range': every position in between, e.g. for chains)
+	template<class Visitor>
+	static void forEachTouchedNode(Solution const& solution,
+		std::size_t lb, std::size_t ub,
+		std::initializer_list<Node> moved, Visitor visit,
+		bool whole_range = false)
+	{
+		auto n = solution.GetInstance()->GetSize();
+		auto visit_at = [&](std::size_t pos) {
+			if (pos > 0 && pos < n)
+				visit(solution.Get(pos)); // depots are never moved
+		};
+		if (whole_range)
+			for (auto pos = lb; pos <= ub && pos < n; ++pos)
+				visit_at(pos);
+		for (std::size_t d = 0; d < 3; ++d) {
+			visit_at(lb + d);
+			if (ub >= d)
+				visit_at(ub - d);
+		}
+		for (auto const& node : moved) {
+			auto pos = solution.GetIndexOf(node);
+			visit_at(pos - 1);
+			visit_at(pos);
+			visit_at(pos + 1);
+		}
+	}
+protected:
+	static constexpr double adaptive_window = 1 << 16;
 	std::default_random_engine rng;
-};
\ No newline at end of file
+	std::shared_ptr<std::pmr::memory_resource> scratch;
+	Perturbation perturbation = Perturbation::Moves;
+	std::shared_ptr<PerturbationBandit> perturbation_bandit;
+	std::size_t perturbation_arm = 0;
+	double perturbation_effort = 0; // moves evaluated since
+	// Hashes of windows (with their position and the nodes around
+	// them) found optimal, which are skipped while unchanged
+	std::unordered_set<std::uint64_t> optimal_windows;
+	static constexpr std::size_t optimal_windows_max = 1 << 20;
+};
+
+// Local search over a compile-time list of neighbourhood
+// operators (see pipeline.h), e.g. to search only a few of
+// them without paying for the dispatch to the others:
+//
+//     BasicLocalSearch<Pipeline<nbh::Shift, nbh::Opt2>> ls(seed);
+template<class Pipeline>
+class BasicLocalSearch : public LocalSearchBase
+{
+public:
+	BasicLocalSearch(std::default_random_engine& rng) :
+		LocalSearchBase(rng),
+		stats(makeStats())
+	{
+		SetNeighbourhoodOrder(Order::Fixed);
+	}
+
+	BasicLocalSearch(unsigned int seed) :
+		LocalSearchBase(seed),
+		stats(makeStats())
+	{
+		SetNeighbourhoodOrder(Order::Fixed);
+	}
+
+	void SetNeighbourhoodOrder(Order order)
+	{
+		this->order = order;
+		std::iota(levels.begin(), levels.end(), 0);
+		improvements.fill(0);
+		evaluations.fill(0);
+		level_bandit.Reset();
+	}
+
+	void SetDescent(Descent descent,
+		std::shared_ptr<parallel::ThreadPool> pool = nullptr)
+	{
+		this->descent = descent;
+		this->pool = pool;
+	}
+
+	// Counters of each neighbourhood since the last reset
+	// (all zero if compiled without MLP_LS_STATS, see stats.h)
+	SearchStats const& GetStats() const
+	{
+		return stats;
+	}
+
+	void ResetStats()
+	{
+		::ResetStats(stats);
+	}
+
+	// Descends from every client, or only from the 'active_nodes'
+	// (e.g. the ones touched by the last perturbation)
+	int findLocalMinimum(Solution& solution,
+		std::vector<Node> const* active_nodes = nullptr);
+private:
+	static SearchStats makeStats();
+	void reorderNeighbourhoods();
+	void countEvaluations(std::size_t nl, std::size_t evaluation_cnt,
+		bool improved, Cost gain);
+	int findBestImprovements(Solution& solution,
+		std::vector<Node> const* active_nodes);
+private:
+	static constexpr std::size_t neighbourhood_level_cnt = Pipeline::size;
+	Order order = Order::Fixed;
+	Descent descent = Descent::FirstImprovement;
+	std::shared_ptr<parallel::ThreadPool> pool;
+	std::array<std::size_t, neighbourhood_level_cnt> levels;
+	std::array<double, neighbourhood_level_cnt> improvements;
+	std::array<double, neighbourhood_level_cnt> evaluations;
+	Bandit<neighbourhood_level_cnt> level_bandit;
+	SearchStats stats;
+};
+
+// Counters named after the operators of the pipeline
+template<class Pipeline>
+SearchStats BasicLocalSearch<Pipeline>::makeStats()
+{
+	SearchStats stats(neighbourhood_level_cnt);
+	for (std::size_t nl = 0; nl < neighbourhood_level_cnt; ++nl)
+		stats[nl].name = Pipeline::names[nl];
+	return stats;
+}
+
+// Called on every restart of the descent (after an improvement)
+template<class Pipeline>
+void BasicLocalSearch<Pipeline>::reorderNeighbourhoods()
+{
+	switch (order) {
+	case Order::Fixed:
+		break;
+	case Order::Random:
+		std::shuffle(levels.begin(), levels.end(), rng);
+		break;
+	case Order::Adaptive: {
+		// Improvements per evaluation, with a prior of 1/1
+		// so that unexplored neighbourhoods are tried early
+		auto ratio = [this](std::size_t nl) {
+			return (improvements[nl] + 1) / (evaluations[nl] + 1);
+		};
+		std::stable_sort(levels.begin(), levels.end(),
+			[&](std::size_t a, std::size_t b) { return ratio(a) > ratio(b); });
+		break;
+	}
+	case Order::Bandit: {
+		// Never tried neighbourhoods first (infinite bound)
+		auto scores = level_bandit.Scores();
+		std::stable_sort(levels.begin(), levels.end(),
+			[&](std::size_t a, std::size_t b) { return scores[a] > scores[b]; });
+		break;
+	}
+	}
+}
+
+// Only the recent history counts for the adaptive order
+// 'gain' is only known if stats are enabled or with the bandit
+template<class Pipeline>
+void BasicLocalSearch<Pipeline>::countEvaluations(std::size_t nl,
+	std::size_t evaluation_cnt, bool improved, Cost gain)
+{
+	perturbation_effort += evaluation_cnt;
+	if (order == Order::Bandit)
+		level_bandit.Reward(nl, (double) gain, (double) evaluation_cnt);
+	evaluations[nl] += evaluation_cnt;
+	improvements[nl] += improved ? 1 : 0;
+	if constexpr (stats_enabled) {
+		stats[nl].evaluations += evaluation_cnt;
+		stats[nl].applied += improved ? 1 : 0;
+		stats[nl].gain += gain;
+	}
+	if (evaluations[nl] > adaptive_window) {
+		evaluations[nl] /= 2;
+		improvements[nl] /= 2;
+	}
+}
+
+template<class Pipeline>
+int BasicLocalSearch<Pipeline>::findLocalMinimum(Solution& solution,
+	std::vector<Node> const* active_nodes)
+{
+	if (descent == Descent::BestImprovement)
+		return findBestImprovements(solution, active_nodes);
+
+	int improvementCount = 0;
+	std::pmr::monotonic_buffer_resource arena(scratch.get());
+
+	// Do a bit of preprocessing
+	auto n = solution.GetInstance()->GetSize();
+	auto gammaset = solution.GetInstance()->GetGammaSet();
+	auto k = gammaset->getK();
+	std::pmr::vector<Node> ni_order(&arena), j_order(k, &arena), r_order(k, &arena);
+	if (active_nodes) {
+		ni_order.assign(active_nodes->begin(), active_nodes->end());
+	} else {
+		ni_order.resize(n - 1);
+		for (Node i = 1; i < n; ++i) ni_order[i - 1] = i;
+	}
+	for (Node i = 0; i < k; ++i) r_order[i] = j_order[i] = i;
+
+	// Shuffle i and j and r orders
+	std::shuffle(ni_order.begin(), ni_order.end(), rng);
+	std::shuffle(j_order.begin(), j_order.end(), rng);
+	std::shuffle(r_order.begin(), r_order.end(), rng);
+
+	// Queue of active nodes (the ones without their don't-look bit)
+	// Nodes leave it once none of their moves improve the solution,
+	// and come back when a move changes their tour neighbourhood
+	std::pmr::deque<Node> active(&arena);
+	std::pmr::vector<bool> queued(n, false, &arena);
+	auto activate = [&](Node node) {
+		if (node == 0 || node >= n || queued[node]) return;
+		queued[node] = true;
+		active.push_back(node);
+	};
+	for (auto const& ni : ni_order)
+		activate(ni);
+	reorderNeighbourhoods();
+
+	// The delta of applied moves is only needed for these
+	bool const track_gain = stats_enabled || order == Order::Bandit;
+
+	while (!active.empty()) {
+		auto ni = active.front();
+		active.pop_front();
+		queued[ni] = false;
+		auto const& ni_neighbours = gammaset->getClosestNeighbours(ni);
+		auto i = solution.GetIndexOf(ni);
+		bool improved = false;
+		for (auto const& nl : levels) {
+			StatsTimer timer(stats[nl]);
+			Node nj = ni, nr = ni;
+			std::size_t lb = 0, ub = n;
+			std::size_t evaluation_cnt = 0;
+			Cost gain = 0;
+			improved = Pipeline::Visit(nl, [&](auto op) {
+				using Operator = typename decltype(op)::type;
+				// Applies the move if it improves the solution
+				auto try_move = [&](std::size_t j, std::size_t r) {
+					++evaluation_cnt;
+					if (!track_gain)
+						return Operator::Apply(solution, *gammaset, i, j, r, &lb, &ub);
+					// Same moves, but their delta is known
+					// (so they are applied without evaluating them again)
+					auto delta = Operator::Evaluate(solution, *gammaset, i, j, r);
+					if (!delta) {
+						if constexpr (stats_enabled)
+							++stats[nl].filter_rejects;
+						return false;
+					}
+					if (*delta >= 0 ||
+						!Operator::Commit(solution, *gammaset, i, j, r, &lb, &ub))
+						return false;
+					gain = -*delta;
+					return true;
+				};
+				for (auto const& nj_ : j_order) {
+					nj = ni_neighbours[nj_];
+					auto j = solution.GetIndexOf(nj);
+					if constexpr (Operator::ternary) {
+						for (auto const& nr_ : r_order) {
+							nr = ni_neighbours[nr_];
+							if (try_move(j, solution.GetIndexOf(nr)))
+								return true;
+						}
+					} else {
+						if (try_move(j, i))
+							return true;
+					}
+				}
+				return false;
+			});
+			countEvaluations(nl, evaluation_cnt, improved, gain);
+			if (improved) {
+				forEachTouchedNode(solution, lb, ub, { ni, nj, nr }, activate,
+					Pipeline::activates_range[nl]);
+				++improvementCount;
+				break;
+			}
+		}
+		if (improved)
+			reorderNeighbourhoods();
+	}
+	return improvementCount;
+}
+
+template<class Pipeline>
+int BasicLocalSearch<Pipeline>::findBestImprovements(Solution& solution,
+	std::vector<Node> const* active_nodes)
+{
+	int improvementCount = 0;
+	std::pmr::monotonic_buffer_resource arena(scratch.get());
+
+	// Do a bit of preprocessing
+	auto n = solution.GetInstance()->GetSize();
+	auto gammaset = solution.GetInstance()->GetGammaSet();
+
+	// Candidates are moves around every client, or around the
+	// active nodes and the ones touched by the moves applied since.
+	// A candidate gets the don't-look bit of a level once none of
+	// its moves there improve the solution, and is dropped with
+	// every bit set, until a move touches it again
+	static_assert(Pipeline::size <= 32, "Don't-look bits per level");
+	std::uint32_t const all_levels = (std::uint32_t) (((std::uint64_t) 1 << Pipeline::size) - 1);
+	std::pmr::vector<Node> candidates(&arena);
+	std::pmr::vector<bool> is_candidate(n, false, &arena);
+	std::pmr::vector<std::uint32_t> dont_look(n, 0, &arena);
+	// Written by the thread evaluating the node alone
+	std::pmr::vector<char> improving(n, 0, &arena);
+	candidates.reserve(n - 1);
+	auto add_candidate = [&](Node node) {
+		if (node == 0 || node >= n) return;
+		dont_look[node] = 0;
+		if (is_candidate[node]) return;
+		is_candidate[node] = true;
+		candidates.push_back(node);
+	};
+	if (active_nodes) {
+		for (auto const& ni : *active_nodes)
+			add_candidate(ni);
+	} else {
+		for (Node ni = 1; ni < n; ++ni)
+			add_candidate(ni);
+	}
+	reorderNeighbourhoods();
+
+	std::mutex best_mutex;
+	for (;;) {
+		move_t best;
+		std::size_t best_nl = 0;
+		for (auto const& nl : levels) {
+			StatsTimer timer(stats[nl]);
+			std::size_t evaluation_cnt = 0;
+			std::uint32_t const bit = (std::uint32_t) 1 << nl;
+
+			// Read-only on the solution, so blocks of candidates
+			// are evaluated in parallel and then reduced
+			auto evaluate = [&](std::size_t begin, std::size_t end) {
+				move_t block_best;
+				std::size_t block_evaluations = 0, block_rejects = 0;
+				Pipeline::Visit(nl, [&](auto op) {
+					using Operator = typename decltype(op)::type;
+					bool node_improving = false;
+					auto consider = [&](move_t const& move,
+						std::optional<Cost> const& delta) {
+						++block_evaluations;
+						if constexpr (stats_enabled)
+							block_rejects += delta ? 0 : 1;
+						if (!delta)
+							return;
+						node_improving |= move.delta < 0;
+						if (move < block_best)
+							block_best = move;
+					};
+					for (auto c = begin; c < end; ++c) {
+						auto ni = candidates[c];
+						if (dont_look[ni] & bit)
+							continue;
+						node_improving = false;
+						auto i = solution.GetIndexOf(ni);
+						auto const& ni_neighbours = gammaset->getClosestNeighbours(ni);
+						for (auto const& nj : ni_neighbours) {
+							auto j = solution.GetIndexOf(nj);
+							if constexpr (Operator::ternary) {
+								for (auto const& nr : ni_neighbours) {
+									auto r = solution.GetIndexOf(nr);
+									auto delta = Operator::Evaluate(solution, *gammaset, i, j, r);
+									consider({ delta.value_or(0), ni, nj, nr }, delta);
+								}
+							} else {
+								auto delta = Operator::Evaluate(solution, *gammaset, i, j, i);
+								consider({ delta.value_or(0), ni, nj, ni }, delta);
+							}
+						}
+						improving[ni] = node_improving;
+					}
+					return false;
+				});
+				std::lock_guard<std::mutex> lock(best_mutex);
+				evaluation_cnt += block_evaluations;
+				if constexpr (stats_enabled)
+					stats[nl].filter_rejects += block_rejects;
+				if (block_best < best)
+					best = block_best;
+			};
+			if (pool)
+				pool->ForBlocks(candidates.size(), evaluate);
+			else
+				evaluate(0, candidates.size());
+
+			for (auto const& ni : candidates)
+				if (!(dont_look[ni] & bit) && !improving[ni])
+					dont_look[ni] |= bit;
+
+			countEvaluations(nl, evaluation_cnt, best.delta < 0,
+				std::max(-best.delta, (Cost) 0));
+			if (best.delta < 0) {
+				best_nl = nl;
+				break;
+			}
+		}
+		if (best.delta >= 0)
+			break; // Local minimum
+
+		auto i = solution.GetIndexOf(best.ni);
+		auto j = solution.GetIndexOf(best.nj);
+		auto r = solution.GetIndexOf(best.nr);
+		std::size_t lb = 0, ub = n;
+		bool improved = Pipeline::Visit(best_nl, [&](auto op) {
+			using Operator = typename decltype(op)::type;
+			StatsTimer timer(stats[best_nl]);
+			return Operator::Commit(solution, *gammaset, i, j, r, &lb, &ub);
+		});
+		if (!improved)
+			break; // Never happens, the move was just evaluated
+		forEachTouchedNode(solution, lb, ub,
+			{ best.ni, best.nj, best.nr }, add_candidate,
+			Pipeline::activates_range[best_nl]);
+		candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+			[&](Node ni) {
+				if (dont_look[ni] != all_levels) return false;
+				is_candidate[ni] = false;
+				return true;
+			}), candidates.end());
+		++improvementCount;
+		reorderNeighbourhoods();
+	}
+	return improvementCount;
+}
+
+// Shift, 2-Opt, Swap and Shift2, instantiated in ls.cpp
+using LocalSearch = BasicLocalSearch<DefaultPipeline>;
+extern template class BasicLocalSearch<DefaultPipeline>;
+
+// The above, and then ejection chains
+using ChainLocalSearch = BasicLocalSearch<ChainPipeline>;
+extern template class BasicLocalSearch<ChainPipeline>;
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#include "solution.h"
+
+// Neighbourhood operators of the local search
+//
+// Each one moves the node at position i next to one of its
+// neighbours at position j (and r, for ternary operators):
+// - name: identifier of the neighbourhood (e.g. in statistics)
+// - activates_range: whether every position between the bounds
+//   of an applied move changed its neighbours (not only the ones
+//   next to the bounds and to the moved nodes)
+// - Apply: applies the move, only if it improves the solution
+// - Evaluate: cost delta of the move, without applying it
+// - Commit: applies a move already evaluated as improving,
+//   without evaluating it again
+// The gamma set is the one of the instance, resolved once per
+// descent by the local search.
+namespace nbh
+{
+	struct Shift
+	{
+		static constexpr char const* name = "shift";
+		static constexpr bool ternary = false;
+		static constexpr bool activates_range = false;
+
+		static bool Apply(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Shift(i, j, true, lb, ub);
+		}
+
+		static bool Commit(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Shift(i, j, false, lb, ub);
+		}
+
+		static std::optional<Cost> Evaluate(Solution const& s,
+			ds::GammaSet const&, std::size_t i, std::size_t j, std::size_t)
+		{
+			return s.GetShiftDelta(i, j);
+		}
+	};
+
+	struct Opt2
+	{
+		static constexpr char const* name = "opt2";
+		static constexpr bool ternary = false;
+		static constexpr bool activates_range = false;
+
+		static bool Apply(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Opt2(i, j, true, lb, ub);
+		}
+
+		static bool Commit(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Opt2(i, j, false, lb, ub);
+		}
+
+		static std::optional<Cost> Evaluate(Solution const& s,
+			ds::GammaSet const&, std::size_t i, std::size_t j, std::size_t)
+		{
+			return s.GetOpt2Delta(i, j);
+		}
+	};
+
+	struct Swap
+	{
+		static constexpr char const* name = "swap";
+		static constexpr bool ternary = false;
+		static constexpr bool activates_range = false;
+
+		static bool Apply(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Swap(i, j, true, lb, ub);
+		}
+
+		static bool Commit(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Swap(i, j, false, lb, ub);
+		}
+
+		static std::optional<Cost> Evaluate(Solution const& s,
+			ds::GammaSet const&, std::size_t i, std::size_t j, std::size_t)
+		{
+			return s.GetSwapDelta(i, j);
+		}
+	};
+
+	struct Shift2
+	{
+		static constexpr char const* name = "shift2";
+		static constexpr bool ternary = true;
+		static constexpr bool activates_range = false;
+
+		static bool Apply(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t r, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Shift2(i, j, r, true, lb, ub);
+		}
+
+		static bool Commit(Solution& s, ds::GammaSet const&,
+			std::size_t i, std::size_t j,
+			std::size_t r, std::size_t* lb, std::size_t* ub)
+		{
+			return s.Shift2(i, j, r, false, lb, ub);
+		}
+
+		static std::optional<Cost> Evaluate(Solution const& s,
+			ds::GammaSet const&, std::size_t i, std::size_t j, std::size_t r)
+		{
+			return s.GetShift2Delta(i, j, r);
+		}
+	};
+
+	// Variable-depth chain (Lin-Kernighan style) of reversals of
+	// consecutive segments, the first one being [i + 1, j], or
+	// [j, i - 1] going backwards if j < i (see pipeline.cpp).
+	// Only its best prefix is applied.
+	struct EjectionChain
+	{
+		static constexpr char const* name = "chain";
+		static constexpr bool ternary = false;
+		static constexpr bool activates_range = true;
+		static constexpr std::size_t max_depth = 6;
+
+		static bool Apply(Solution& s, ds::GammaSet const& gammaset,
+			std::size_t i, std::size_t j,
+			std::size_t, std::size_t* lb, std::size_t* ub);
+
+		static std::optional<Cost> Evaluate(Solution const& s,
+			ds::GammaSet const& gammaset, std::size_t i, std::size_t j,
+			std::size_t);
+
+		static bool Commit(Solution& s, ds::GammaSet const& gammaset,
+			std::size_t i, std::size_t j,
+			std::size_t r, std::size_t* lb, std::size_t* ub)
+		{
+			// The chain is built again
+			return Apply(s, gammaset, i, j, r, lb, ub);
+		}
+	private:
+		// Ends of the segments (their starts, going backwards)
+		using ends_t = std::array<std::size_t, max_depth>;
+		static std::optional<Cost> build(Solution const& s,
+			ds::GammaSet const& gammaset, std::size_t i, std::size_t j,
+			ends_t& ends, std::size_t& depth);
+	};
+}
+
+// Compile-time list of neighbourhood operators
+//
+// Levels are dispatched once, through a table of functions,
+// so that the loops over the candidates of each level are
+// compiled (and inlined) for its operator alone.
+template<class... Operators>
+struct Pipeline
+{
+	static_assert(sizeof...(Operators) > 0, "Empty pipeline");
+
+	static constexpr std::size_t size = sizeof...(Operators);
+
+	// Names of the operators, by level
+	static constexpr char const* names[] = { Operators::name... };
+
+	// Whether applied moves change every position within
+	// their bounds, by level (see nbh above)
+	static constexpr bool activates_range[] = { Operators::activates_range... };
+
+	// Tag of the operator passed on to visitors
+	template<class Operator>
+	struct tag_t
+	{
+		using type = Operator;
+	};
+
+	// Calls visit(tag_t<Operator>{}) for the operator of 'level'
+	template<class Visitor>
+	static bool Visit(std::size_t level, Visitor&& visit)
+	{
+		using fn_t = bool (*)(Visitor&);
+		static constexpr fn_t table[] = { &call<Visitor, Operators>... };
+		return table[level](visit);
+	}
+
+private:
+	template<class Visitor, class Operator>
+	static bool call(Visitor& visit)
+	{
+		return visit(tag_t<Operator>{});
+	}
+};
+
+// Shift, 2-Opt, Swap, Shift2
+using DefaultPipeline = Pipeline<nbh::Shift, nbh::Opt2, nbh::Swap, nbh::Shift2>;
+
+// The above, and then ejection chains (e.g. for long runs
+// on large instances, where the moves above stall)
+using ChainPipeline = Pipeline<nbh::Shift, nbh::Opt2, nbh::Swap, nbh::Shift2,
+	nbh::EjectionChain>;
\ No newline at end of file
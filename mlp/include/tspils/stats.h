@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <vector>
+
+#include "solution.h"
+
+// Counters of the local search are compiled in unless MLP_LS_STATS
+// is defined as 0 (see the MLP_LS_STATS option of CMakeLists.txt),
+// in which case they are left at zero, at no cost for the search
+#ifndef MLP_LS_STATS
+#define MLP_LS_STATS 1
+#endif
+
+// Counters of a neighbourhood of the local search
+struct NeighbourhoodStats
+{
+	char const* name = "";
+	unsigned long long evaluations = 0; // moves tried
+	unsigned long long filter_rejects = 0; // of them, filtered out (invalid positions)
+	unsigned long long applied = 0; // improving moves applied
+	Cost gain = 0; // cost decrease of the moves applied
+	double wall_seconds = 0;
+	double cpu_seconds = 0; // of the whole process (e.g. thread pools)
+
+	NeighbourhoodStats& operator+= (NeighbourhoodStats const& stats);
+};
+
+// Counters of each neighbourhood, in pipeline order
+using SearchStats = std::vector<NeighbourhoodStats>;
+
+// Adds the counters of 'stats' to the ones of 'total',
+// which takes its neighbourhoods if still empty
+void AccumulateStats(SearchStats& total, SearchStats const& stats);
+void ResetStats(SearchStats& stats);
+
+// Measures the wall and CPU time of its lifetime into 'stats'
+// (or nothing, if MLP_LS_STATS is 0)
+class StatsTimer
+{
+public:
+#if MLP_LS_STATS
+	StatsTimer(NeighbourhoodStats& stats) :
+		stats(stats),
+		wall_start(std::chrono::steady_clock::now()),
+		cpu_start(std::clock())
+	{}
+
+	~StatsTimer()
+	{
+		std::chrono::duration<double> wall =
+			std::chrono::steady_clock::now() - wall_start;
+		stats.wall_seconds += wall.count();
+		stats.cpu_seconds += (double) (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+	}
+
+	StatsTimer(StatsTimer const&) = delete;
+	StatsTimer& operator= (StatsTimer const&) = delete;
+private:
+	NeighbourhoodStats& stats;
+	std::chrono::steady_clock::time_point wall_start;
+	std::clock_t cpu_start;
+#else
+	StatsTimer(NeighbourhoodStats&) {}
+#endif
+};
\ No newline at end of file
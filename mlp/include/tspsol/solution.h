@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <map>
+#include <memory_resource>
 #include <random>
 #include <optional>
 #include <vector>
@@ -11,25 +14,48 @@
 #include "instance.h"
 #include "bksparser.h"
 
+// Memory resource of a solution, and of its copies
+// (null = default resource). Being a base of Solution, it
+// outlives the nodes and maps allocated from it.
+struct SolutionResource
+{
+	std::shared_ptr<std::pmr::memory_resource> resource;
+
+	std::pmr::memory_resource* memory() const
+	{
+		return resource ? resource.get() : std::pmr::get_default_resource();
+	}
+};
+
 // A solution is represented by a sequence of nodes
 // <s0, s1, ..., sn-1, sn>
 //
 // - n is the dimension of the distance matrix
 // - s0 and sn are both the depot.
 // - s1 and sn-1 are distinct clients
-class Solution : public std::list<Node>
+class Solution : private SolutionResource, public std::pmr::list<Node>
 {
 public:
 	Solution (Solution const& solution);
+	Solution (Solution const& solution,
+		std::shared_ptr<std::pmr::memory_resource> resource);
 	Solution (std::shared_ptr<Instance> instance_ptr,
 		std::size_t window_size = 1,
 		std::default_random_engine& rng = std::default_random_engine(0));
+	Solution (std::shared_ptr<Instance> instance_ptr,
+		std::size_t window_size, std::default_random_engine& rng,
+		std::shared_ptr<std::pmr::memory_resource> resource);
+	// Copies the nodes of 'solution', reusing the memory
+	// of this one (its resource is kept)
+	Solution& operator= (Solution const& solution);
 	std::shared_ptr<Instance> GetInstance () const;
 	std::optional<double> GetCostGap () const;
 
 	Node Get (std::size_t index) const;
 	std::size_t GetIndexOf (Node node) const;
 	Cost GetLatencyAt (std::size_t index) const;
+	// sum of the latencies of positions p to q, in O(1)
+	Cost GetLatencySum (std::size_t p, std::size_t q) const;
 	Dist GetDist (Node i, Node j) const;
 	Cost GetCost () const;
 
@@ -47,6 +73,28 @@ public:
 	bool Opt2 (std::size_t p, std::size_t q, bool improve, std::size_t* lb = nullptr, std::size_t* ub = nullptr);
 	bool Shift2 (std::size_t p, std::size_t q, std::size_t r, bool improve, std::size_t* lb = nullptr, std::size_t* ub = nullptr);
 
+	// reverses the nodes from position p to q, whatever the cost
+	// (e.g. for chains of moves, which only improve as a whole)
+	void Reverse (std::size_t p, std::size_t q);
+
+	// replaces the nodes from position p on by [first, last),
+	// which must be a permutation of them (e.g. for perturbations)
+	template<class Iterator>
+	void Rearrange (std::size_t p, Iterator first, Iterator last)
+	{
+		if (first == last) return;
+		std::copy(first, last, std::next(begin(), p));
+		recalculateLatencyMap(p);
+	}
+
+	// cost deltas of the neighbourhood moves, without applying them
+	// nullopt = invalid move (same filtering as the moves above)
+	// only read the solution, so may be called from many threads
+	std::optional<Cost> GetShiftDelta (std::size_t p, std::size_t q) const;
+	std::optional<Cost> GetSwapDelta (std::size_t p, std::size_t q) const;
+	std::optional<Cost> GetOpt2Delta (std::size_t p, std::size_t q) const;
+	std::optional<Cost> GetShift2Delta (std::size_t p, std::size_t q, std::size_t r) const;
+
 	// for debugging
 	bool IsValid () const;
 	unsigned long long GetId () const;
@@ -57,10 +105,25 @@ public:
 	friend Solution* crossover(Solution const& sa, Solution const& sb,
 		std::default_random_engine &rng);
 private:
+	Solution (std::shared_ptr<std::pmr::memory_resource> resource);
 	void recalculateLatencyMap(std::size_t start = 0);
+	bool filterShift (std::size_t p, std::size_t q) const;
+	bool filterSwap (std::size_t& p, std::size_t& q) const;
+	bool filterOpt2 (std::size_t& p, std::size_t& q) const;
+	bool filterShift2 (std::size_t& p, std::size_t& q, std::size_t r) const;
+	Cost shiftDelta (std::size_t p, std::size_t q) const;
+	Cost swapDelta (std::size_t p, std::size_t q) const;
+	Cost opt2Delta (std::size_t p, std::size_t q) const;
+	Cost shift2Delta (std::size_t p, std::size_t q, std::size_t r) const;
 private:
-	std::vector<Cost> latency_map;
+	std::pmr::vector<Cost> latency_map;
+	std::pmr::vector<Cost> latency_sum_map; // prefix sums of the above
+	std::pmr::vector<Node> node_map; // position -> node
+	std::pmr::vector<std::size_t> index_map; // node -> position
 	std::shared_ptr<Instance> instance_ptr;
+	// of the instance, which is loaded once, when the
+	// solution is built (so lookups do not check it)
+	ds::SquareMatrix<Dist> const* dmatrix = nullptr;
 	unsigned long long _id;
 	static unsigned long long _count;
 };
@@ -0,0 +1,96 @@
+#include "cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "image.h"
+#include "tokenizer.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::atomic<bool> enabled { true };
+}
+
+std::string InstanceCache::GetPath(std::string const& filename)
+{
+	return fs::path(filename).replace_extension(".tspb").string();
+}
+
+std::uint64_t InstanceCache::GetStamp(std::string_view contents)
+{
+	//
+	// FNV-1a over the contents, 8 bytes at a time
+	//
+	std::uint64_t hash = 14695981039346656037ull;
+	std::size_t i = 0;
+	for (; i + 8 <= contents.size(); i += 8) {
+		std::uint64_t word = 0;
+		for (std::size_t b = 0; b < 8; ++b)
+			word |= std::uint64_t((unsigned char) contents[i + b]) << (8 * b);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	for (; i < contents.size(); ++i)
+		hash = (hash ^ (unsigned char) contents[i]) * 1099511628211ull;
+	return hash ^ contents.size();
+}
+
+std::optional<std::shared_ptr<Instance>> InstanceCache::Read(
+	std::string const& filename, std::uint64_t stamp)
+{
+	auto file = FileBuffer::Open(GetPath(filename));
+	if (!file)
+		return std::nullopt;
+	auto view = file->View();
+	auto stamp_opt = InstanceImage::GetStamp(view.data(), view.size());
+	if (!stamp_opt || *stamp_opt != stamp)
+		return std::nullopt; // outdated (or not a cache)
+	auto instance_opt = InstanceImage::Read(view.data(), view.size(), file);
+	if (instance_opt)
+		(*instance_opt)->filepath = filename;
+	return instance_opt;
+}
+
+bool InstanceCache::Write(Instance const& instance, std::uint64_t stamp)
+{
+	if (!instance.Load())
+		return false;
+	std::vector<char> image(InstanceImage::GetSize(instance));
+	if (!InstanceImage::Write(instance, stamp, image.data(), image.size()))
+		return false;
+
+	//
+	// Written aside, then renamed, so no process
+	// ever maps a partially written cache
+	//
+	auto path = GetPath(instance.GetSourceFilePath());
+	auto temp_path = path + "." + std::to_string(
+		std::chrono::steady_clock::now().time_since_epoch().count());
+	bool written;
+	{
+		std::ofstream ofs(temp_path, std::ios::out | std::ios::binary);
+		written = ofs.write(image.data(), image.size()).good();
+	}
+	std::error_code ec;
+	if (written)
+		fs::rename(temp_path, path, ec);
+	if (!written || ec) {
+		fs::remove(temp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+void InstanceCache::SetEnabled(bool enabled)
+{
+	::enabled.store(enabled);
+}
+
+bool InstanceCache::IsEnabled()
+{
+	return enabled.load();
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "distance.h"
+
+#include <cmath>
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+	//
+	// Every kernel computes a row of distances from the node at
+	// (xi, yi) to the nodes at (xs[j], ys[j]). The coordinates are
+	// split in two arrays and the loops have no branches, so the
+	// compiler can vectorize them.
+	//
+
+	void euclidean(Pos xi, Pos yi, Pos const* xs, Pos const* ys,
+		std::size_t n, Dist* row)
+	{
+		for (std::size_t j = 0; j < n; ++j) {
+			Pos dx = xs[j] - xi, dy = ys[j] - yi;
+			row[j] = (Dist) (std::sqrt(dx * dx + dy * dy) + 0.5);
+		}
+	}
+
+	void ceiling(Pos xi, Pos yi, Pos const* xs, Pos const* ys,
+		std::size_t n, Dist* row)
+	{
+		for (std::size_t j = 0; j < n; ++j) {
+			Pos dx = xs[j] - xi, dy = ys[j] - yi;
+			Pos r = std::sqrt(dx * dx + dy * dy);
+			Pos t = (Pos) (Dist) r;
+			row[j] = (Dist) (t + (t < r ? 1.0 : 0.0));
+		}
+	}
+
+	void manhattan(Pos xi, Pos yi, Pos const* xs, Pos const* ys,
+		std::size_t n, Dist* row)
+	{
+		for (std::size_t j = 0; j < n; ++j)
+			row[j] = (Dist) (std::abs(xs[j] - xi) + std::abs(ys[j] - yi) + 0.5);
+	}
+
+	void pseudo(Pos xi, Pos yi, Pos const* xs, Pos const* ys,
+		std::size_t n, Dist* row)
+	{
+		for (std::size_t j = 0; j < n; ++j) {
+			Pos dx = xs[j] - xi, dy = ys[j] - yi;
+			Pos r = std::sqrt((dx * dx + dy * dy) / 10.0);
+			Pos t = (Pos) (Dist) (r + 0.5);
+			row[j] = (Dist) (t + (t < r ? 1.0 : 0.0));
+		}
+	}
+
+	//
+	// GEO coordinates are in DDD.MM format (degrees, minutes),
+	// and xs, ys hold their latitudes and longitudes in radians
+	//
+	void geographic(Pos lat_i, Pos long_i, Pos const* lats,
+		Pos const* longs, std::size_t n, Dist* row)
+	{
+		constexpr double radius = 6378.388;
+		for (std::size_t j = 0; j < n; ++j) {
+			double q1 = std::cos(long_i - longs[j]);
+			double q2 = std::cos(lat_i - lats[j]);
+			double q3 = std::cos(lat_i + lats[j]);
+			row[j] = (Dist) (radius * std::acos(0.5 * ((1.0 + q1) * q2 -
+				(1.0 - q1) * q3)) + 1.0);
+		}
+	}
+
+	double toRadians(Pos coord)
+	{
+		constexpr double pi = 3.141592;
+		double degrees = (double) (long long) coord;
+		double minutes = coord - degrees;
+		return pi * (degrees + 5.0 * minutes / 3.0) / 180.0;
+	}
+}
+
+std::optional<EdgeWeightType> GetEdgeWeightType(std::string const& name)
+{
+	if (name == "EXPLICIT") return EdgeWeightType::Explicit;
+	if (name == "EUC_2D") return EdgeWeightType::Euclidean;
+	if (name == "CEIL_2D") return EdgeWeightType::Ceiling;
+	if (name == "GEO") return EdgeWeightType::Geographic;
+	if (name == "ATT") return EdgeWeightType::Pseudo;
+	if (name == "MAN_2D") return EdgeWeightType::Manhattan;
+	return std::nullopt;
+}
+
+std::shared_ptr<ds::SquareMatrix<Dist>> ComputeDistanceMatrix(
+	EdgeWeightType type, ds::Matrix<Pos> const& coords, std::size_t threads)
+{
+	auto n = coords.getm();
+
+	//
+	// Coordinates as structure of arrays
+	//
+	std::vector<Pos> xs(n), ys(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		xs[i] = coords[i][0];
+		ys[i] = coords[i][1];
+		if (type == EdgeWeightType::Geographic) {
+			xs[i] = toRadians(xs[i]);
+			ys[i] = toRadians(ys[i]);
+		}
+	}
+
+	using kernel_t = void(*)(Pos, Pos, Pos const*, Pos const*,
+		std::size_t, Dist*);
+	kernel_t kernel = nullptr;
+	switch (type) {
+	case EdgeWeightType::Euclidean: kernel = euclidean; break;
+	case EdgeWeightType::Ceiling: kernel = ceiling; break;
+	case EdgeWeightType::Geographic: kernel = geographic; break;
+	case EdgeWeightType::Pseudo: kernel = pseudo; break;
+	case EdgeWeightType::Manhattan: kernel = manhattan; break;
+	default: return nullptr;
+	}
+
+	auto dmatrix = ds::SquareMatrix<Dist>::Get(n);
+	parallel::ForBlocks(n, threads, [&] (std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; ++i) {
+			auto row = (*dmatrix)[i];
+			kernel(xs[i], ys[i], xs.data(), ys.data(), n, row);
+			row[i] = 0;
+		}
+	});
+	return dmatrix;
+}
\ No newline at end of file
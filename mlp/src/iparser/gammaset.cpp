@@ -1,34 +1,396 @@
 #include "gammaset.h"
 
 #include <algorithm>
-#include <set>
-#include <functional>
+#include <array>
+#include <cmath>
+#include <vector>
 
 #include "instance.h"
+#include "onetree.h"
+#include "parallel.h"
 
 using namespace ds;
 
-GammaSet::GammaSet(Instance const& instance, std::size_t k)
+namespace
 {
-	auto n = instance.GetSize();
-	this->k = k = std::clamp(k, (std::size_t) 1, n - 1);
-	for (Node node = 0; node < n; ++node) {
-		auto order = [instance, node] (Node const& a, Node const& b) {
-			auto da = instance[node][a];
-			auto db = instance[node][b];
+	//
+	// Orders nodes by their distance from a given node
+	// Ties are broken by the node index
+	//
+	struct closer_t
+	{
+		Dist const* dists;
+		bool operator()(Node const& a, Node const& b) const
+		{
+			auto da = dists[a];
+			auto db = dists[b];
 			return da < db || (da == db && a < b);
-		};
-		auto ordered_set = std::set<Node, decltype(order)>(order);
-		for (Node neighbour = 0; neighbour < n; ++neighbour) {
-			if (neighbour == node) continue;
-			ordered_set.insert(neighbour);
-		}
-		map[node] = std::vector<Node>(ordered_set.begin(),
-			std::next(ordered_set.begin(), k));
+		}
+	};
+
+	//
+	// Uniform grid over the node positions,
+	// with about 2 nodes per cell
+	//
+	class grid_t
+	{
+	public:
+		grid_t(ds::Matrix<Pos> const& pos) :
+			pos(pos), n(pos.getm())
+		{
+			min_x = max_x = pos[0][0];
+			min_y = max_y = pos[0][1];
+			for (Node i = 1; i < n; ++i) {
+				min_x = std::min(min_x, pos[i][0]);
+				max_x = std::max(max_x, pos[i][0]);
+				min_y = std::min(min_y, pos[i][1]);
+				max_y = std::max(max_y, pos[i][1]);
+			}
+			cols = rows = std::max((std::size_t) 1,
+				(std::size_t) std::ceil(std::sqrt(n / 2.0)));
+			cell_w = (max_x - min_x) / cols;
+			cell_h = (max_y - min_y) / rows;
+			if (cell_w <= 0) cell_w = 1;
+			if (cell_h <= 0) cell_h = 1;
+
+			//
+			// Counting sort of nodes by cell
+			//
+			cell_start.assign(cols * rows + 1, 0);
+			for (Node i = 0; i < n; ++i)
+				++cell_start[cellOf(i) + 1];
+			for (std::size_t c = 0; c < cols * rows; ++c)
+				cell_start[c + 1] += cell_start[c];
+			cell_nodes.resize(n);
+			auto next = cell_start;
+			for (Node i = 0; i < n; ++i)
+				cell_nodes[next[cellOf(i)]++] = i;
+		}
+
+		std::size_t colOf(Node i) const
+		{
+			auto c = (std::size_t) std::max(0.0, (pos[i][0] - min_x) / cell_w);
+			return std::min(c, cols - 1);
+		}
+
+		std::size_t rowOf(Node i) const
+		{
+			auto r = (std::size_t) std::max(0.0, (pos[i][1] - min_y) / cell_h);
+			return std::min(r, rows - 1);
+		}
+
+		std::size_t cellOf(Node i) const
+		{
+			return rowOf(i) * cols + colOf(i);
+		}
+
+		//
+		// Calls f(j) for every node j in the cells at
+		// Chebyshev distance r from cell (c, r)
+		//
+		template<class F>
+		void forEachInRing(std::size_t c, std::size_t r, std::size_t ring,
+			F const& f) const
+		{
+			long long c0 = (long long) c - ring, c1 = (long long) c + ring;
+			long long r0 = (long long) r - ring, r1 = (long long) r + ring;
+			for (long long y = std::max(r0, 0LL);
+			     y <= std::min(r1, (long long) rows - 1); ++y) {
+				bool full_row = (y == r0 || y == r1);
+				long long step = full_row ? 1 : std::max(c1 - c0, 1LL);
+				for (long long x = c0; x <= c1; x += step) {
+					if (x < 0 || x >= (long long) cols)
+						continue;
+					auto cell = (std::size_t) y * cols + (std::size_t) x;
+					for (auto it = cell_start[cell]; it < cell_start[cell + 1]; ++it)
+						f(cell_nodes[it]);
+				}
+			}
+		}
+
+		//
+		// Positions not yet visited after visiting the rings up
+		// to 'ring' are at least this far away from cell (c, r)
+		//
+		Pos coveredRadius(std::size_t ring) const
+		{
+			return ring * std::min(cell_w, cell_h);
+		}
+
+		bool coversLeft(std::size_t c, std::size_t ring) const { return c <= ring; }
+		bool coversRight(std::size_t c, std::size_t ring) const { return c + ring >= cols - 1; }
+		bool coversBottom(std::size_t r, std::size_t ring) const { return r <= ring; }
+		bool coversTop(std::size_t r, std::size_t ring) const { return r + ring >= rows - 1; }
+
+	private:
+		ds::Matrix<Pos> const& pos;
+		std::size_t n, cols, rows;
+		Pos min_x, max_x, min_y, max_y, cell_w, cell_h;
+		std::vector<std::size_t> cell_start;
+		std::vector<Node> cell_nodes;
+	};
+
+	//
+	// Quadrant of 'j' around 'i', counter-clockwise
+	// from the positive x axis
+	//
+	int quadrantOf(ds::Matrix<Pos> const& pos, Node i, Node j)
+	{
+		auto dx = pos[j][0] - pos[i][0], dy = pos[j][1] - pos[i][1];
+		if (dx > 0 && dy >= 0) return 0;
+		if (dx <= 0 && dy > 0) return 1;
+		if (dx < 0 && dy <= 0) return 2;
+		if (dx >= 0 && dy < 0) return 3;
+		return 0; // same position
 	}
 }
 
-std::vector<Node> const& GammaSet::getClosestNeighbours(Node node) const
+GammaSet::GammaSet(Instance const& instance, std::size_t k,
+	std::size_t threads, Strategy strategy) :
+	n(instance.GetSize())
+{
+	this->k = stride = k = std::clamp(k, (std::size_t) 1, n - 1);
+	auto matrix = constructsContiguousBlock<Node>(n * k);
+	block = matrix;
+	rows = matrix.get();
+
+	//
+	// Spatial strategies only apply to instances whose
+	// distances agree with the node positions
+	//
+	bool spatial = strategy == Strategy::Grid ||
+		strategy == Strategy::Quadrant;
+	bool alpha = strategy == Strategy::Alpha ||
+		strategy == Strategy::AlphaAscent;
+	if (spatial && instance.HasConsistentCoordinates())
+		buildFromGrid(instance, matrix.get(), threads,
+			strategy == Strategy::Quadrant);
+	else if (alpha && n > 2)
+		buildAlpha(instance, matrix.get(), threads,
+			strategy == Strategy::AlphaAscent);
+	else
+		buildNearest(instance, matrix.get(), threads);
+	buildAdjacency();
+}
+
+void GammaSet::buildNearest(Instance const& instance, Node* matrix,
+	std::size_t threads)
+{
+	//
+	// Rows are independent, so each thread builds
+	// a block of them
+	//
+	parallel::ForBlocks(n, threads, [&] (Node first, Node last) {
+
+		//
+		// Candidates of every row, reused
+		//
+		std::vector<Node> candidates(n - 1);
+
+		for (Node node = first; node < last; ++node) {
+			closer_t order { instance[node] };
+			auto it = candidates.begin();
+			for (Node neighbour = 0; neighbour < n; ++neighbour)
+				if (neighbour != node)
+					*it++ = neighbour;
+
+			//
+			// Only the k closest neighbours are sorted
+			//
+			auto kth = std::next(candidates.begin(), k);
+			if (kth != candidates.end())
+				std::nth_element(candidates.begin(), kth,
+					candidates.end(), order);
+			std::sort(candidates.begin(), kth, order);
+			std::copy(candidates.begin(), kth, matrix + node * k);
+		}
+	});
+}
+
+void GammaSet::buildFromGrid(Instance const& instance, Node* matrix,
+	std::size_t threads, bool quadrants)
+{
+	auto const& pos = *instance.GetPositionMatrix();
+	grid_t grid(pos);
+
+	//
+	// Nodes taken from each quadrant
+	// (the remaining ones are the nearest overall)
+	//
+	std::size_t const per_quadrant = quadrants ? k / 4 : 0;
+
+	parallel::ForBlocks(n, threads, [&] (Node first, Node last) {
+
+		std::vector<Node> candidates, row;
+		std::array<std::vector<Node>, 4> by_quadrant;
+		std::vector<bool> chosen(n, false);
+
+		for (Node node = first; node < last; ++node) {
+			closer_t order { instance[node] };
+			auto c = grid.colOf(node), r = grid.rowOf(node);
+
+			//
+			// Checks whether the 'count' closest nodes among
+			// 'nodes' are surely closer than any node not
+			// visited yet. Distances are assumed to be within
+			// one unit of the euclidean distance.
+			//
+			auto settled = [&] (std::vector<Node>& nodes,
+				std::size_t count, Pos radius) {
+				if (count == 0)
+					return true;
+				if (nodes.size() < count)
+					return false;
+				auto nth = std::next(nodes.begin(), count - 1);
+				std::nth_element(nodes.begin(), nth, nodes.end(), order);
+				return order.dists[*nth] < radius - 1;
+			};
+
+			candidates.clear();
+			for (auto& q : by_quadrant) q.clear();
+
+			for (std::size_t ring = 0; ; ++ring) {
+				grid.forEachInRing(c, r, ring, [&] (Node j) {
+					if (j == node) return;
+					candidates.push_back(j);
+					if (per_quadrant)
+						by_quadrant[quadrantOf(pos, node, j)].push_back(j);
+				});
+
+				bool left = grid.coversLeft(c, ring),
+					right = grid.coversRight(c, ring),
+					bottom = grid.coversBottom(r, ring),
+					top = grid.coversTop(r, ring);
+
+				if (left && right && bottom && top)
+					break; // visited every node
+
+				auto radius = grid.coveredRadius(ring);
+				if (!settled(candidates, k, radius))
+					continue;
+
+				if (per_quadrant) {
+					std::array<bool, 4> exhausted = {
+						right && top, left && top,
+						left && bottom, right && bottom };
+					bool all_settled = true;
+					for (int q = 0; q < 4 && all_settled; ++q)
+						all_settled = exhausted[q] ||
+							settled(by_quadrant[q], per_quadrant, radius);
+					if (!all_settled)
+						continue;
+				}
+
+				break;
+			}
+
+			//
+			// Nearest nodes of each quadrant first,
+			// then the nearest ones overall
+			//
+			row.clear();
+			for (auto& q : by_quadrant) {
+				auto count = std::min(per_quadrant, q.size());
+				std::partial_sort(q.begin(), std::next(q.begin(), count),
+					q.end(), order);
+				for (std::size_t i = 0; i < count; ++i) {
+					row.push_back(q[i]);
+					chosen[q[i]] = true;
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), order);
+			for (auto it = candidates.begin();
+			     it != candidates.end() && row.size() < k; ++it)
+				if (!chosen[*it])
+					row.push_back(*it);
+			for (auto const& j : row)
+				chosen[j] = false;
+
+			std::sort(row.begin(), row.end(), order);
+			std::copy(row.begin(), row.end(), matrix + node * k);
+		}
+	});
+}
+
+void GammaSet::buildAlpha(Instance const& instance, Node* matrix,
+	std::size_t threads, bool ascent)
+{
+	std::vector<double> pi;
+	if (ascent)
+		pi = OneTree::Ascent(instance);
+	OneTree tree(instance, pi);
+
+	parallel::ForBlocks(n, threads, [&] (Node first, Node last) {
+
+		std::vector<double> alphas, beta;
+		std::vector<Node> mark(n, 0), candidates(n - 1);
+
+		for (Node node = first; node < last; ++node) {
+			tree.computeAlphas(node, alphas, beta, mark);
+
+			//
+			// Ordered by alpha-nearness, then by distance
+			//
+			auto const* dists = instance[node];
+			auto order = [&] (Node const& a, Node const& b) {
+				if (alphas[a] != alphas[b])
+					return alphas[a] < alphas[b];
+				return dists[a] < dists[b] || (dists[a] == dists[b] && a < b);
+			};
+
+			auto it = candidates.begin();
+			for (Node neighbour = 0; neighbour < n; ++neighbour)
+				if (neighbour != node)
+					*it++ = neighbour;
+			auto kth = std::next(candidates.begin(), k);
+			if (kth != candidates.end())
+				std::nth_element(candidates.begin(), kth,
+					candidates.end(), order);
+			std::sort(candidates.begin(), kth, order);
+			std::copy(candidates.begin(), kth, matrix + node * k);
+		}
+	});
+}
+
+GammaSet::GammaSet(Node const* rows, std::size_t n, std::size_t k,
+	std::shared_ptr<void const> owner) :
+	n(n), k(k), stride(k), block(owner), rows(rows)
+{
+	buildAdjacency();
+}
+
+GammaSet GammaSet::View(std::size_t k) const
+{
+	GammaSet view = *this;
+	view.k = std::clamp(k, (std::size_t) 1, stride);
+	if (view.k != this->k)
+		view.buildAdjacency();
+	return view;
+}
+
+void GammaSet::buildAdjacency()
 {
-	return map.at(node);
+	auto a = std::make_shared<adjacency_t>();
+	a->words = (n + 63) / 64;
+	a->bits.assign(n * a->words, 0);
+	a->start.assign(n + 1, 0);
+	a->nodes.resize(n * k);
+
+	//
+	// Counting sort of the (i, j) pairs by j, so every
+	// reverse list comes out in increasing order of i
+	//
+	for (Node i = 0; i < n; ++i)
+		for (auto const& j : getClosestNeighbours(i)) {
+			a->bits[i * a->words + j / 64] |= std::uint64_t(1) << (j % 64);
+			++a->start[j + 1];
+		}
+	for (Node j = 0; j < n; ++j)
+		a->start[j + 1] += a->start[j];
+	std::vector<std::size_t> next(a->start.begin(), a->start.end() - 1);
+	for (Node i = 0; i < n; ++i)
+		for (auto const& j : getClosestNeighbours(i))
+			a->nodes[next[j]++] = i;
+
+	adjacency = a;
 }
\ No newline at end of file
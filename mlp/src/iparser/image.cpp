@@ -0,0 +1,228 @@
+#include "image.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+
+#include "ds.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr char image_magic[4] = { 'M', 'L', 'P', 'I' };
+	constexpr std::uint32_t image_version = 3;
+	constexpr std::uint32_t image_word_sizes =
+		sizeof(Dist) | (sizeof(Node) << 8) | (sizeof(Pos) << 16);
+	constexpr std::size_t image_alignment = 64;
+
+	struct header_t
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t word_sizes;
+		std::uint32_t strategy; // of the gamma set
+		std::uint64_t size;
+		std::uint64_t stamp;
+		std::uint64_t dimension;
+		std::uint64_t k; // nodes stored per gamma set row
+		std::uint64_t view_k; // nodes of the current gamma set
+		std::uint64_t pos_cols;
+		std::uint64_t name_off, name_len;
+		std::uint64_t comment_off, comment_len;
+		std::uint64_t filepath_off, filepath_len;
+		std::uint64_t dmatrix_off;
+		std::uint64_t posmatrix_off;
+		std::uint64_t gammaset_off;
+	};
+
+	std::uint64_t fnv1a(void const* data, std::size_t size,
+		std::uint64_t hash = 14695981039346656037ull)
+	{
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::uint64_t align(std::uint64_t offset)
+	{
+		return (offset + image_alignment - 1) / image_alignment
+			* image_alignment;
+	}
+
+	//
+	// Computes the offsets of every section of the image
+	// Returns the total image size
+	//
+	std::uint64_t layout(header_t& h)
+	{
+		std::uint64_t offset = align(sizeof(header_t));
+		h.name_off = offset;
+		offset = align(offset + h.name_len);
+		h.comment_off = offset;
+		offset = align(offset + h.comment_len);
+		h.filepath_off = offset;
+		offset = align(offset + h.filepath_len);
+		h.dmatrix_off = offset;
+		offset = align(offset + h.dimension * h.dimension * sizeof(Dist));
+		h.posmatrix_off = offset;
+		offset = align(offset + h.dimension * h.pos_cols * sizeof(Pos));
+		h.gammaset_off = offset;
+		offset = align(offset + h.dimension * h.k * sizeof(Node));
+		return offset;
+	}
+
+	header_t makeHeader(Instance const& instance,
+		std::shared_ptr<ds::GammaSet const> const& gammaset,
+		std::shared_ptr<ds::GammaSet const> const& ordering)
+	{
+		header_t h{};
+		std::memcpy(h.magic, image_magic, sizeof(image_magic));
+		h.version = image_version;
+		h.word_sizes = image_word_sizes;
+		h.dimension = instance.GetSize();
+		h.k = gammaset ? ordering->getMaxK() : 0;
+		h.view_k = gammaset ? gammaset->getK() : 0;
+		auto posmatrix = instance.GetPositionMatrix();
+		h.pos_cols = posmatrix ? posmatrix->getn() : 0;
+		h.name_len = instance.GetName().size();
+		h.comment_len = instance.GetComment().size();
+		h.filepath_len = instance.GetSourceFilePath().size();
+		h.size = layout(h);
+		return h;
+	}
+
+	std::optional<header_t> readHeader(void const* buffer, std::size_t size)
+	{
+		if (size < sizeof(header_t)) {
+			std::cerr << "Instance image is too small.\n";
+			return std::nullopt;
+		}
+		header_t h;
+		std::memcpy(&h, buffer, sizeof(header_t));
+		if (std::memcmp(h.magic, image_magic, sizeof(image_magic)) != 0 ||
+			h.version != image_version ||
+			h.word_sizes != image_word_sizes) {
+			std::cerr << "Instance image has an unsupported format.\n";
+			return std::nullopt;
+		}
+		auto expected = h;
+		if (h.dimension == 0 || h.k >= h.dimension || h.view_k > h.k ||
+			h.strategy > (std::uint32_t) ds::GammaSet::Strategy::AlphaAscent ||
+			layout(expected) != h.size || h.size > size ||
+			expected.gammaset_off != h.gammaset_off) {
+			std::cerr << "Instance image is corrupted.\n";
+			return std::nullopt;
+		}
+		return h;
+	}
+}
+
+std::optional<std::uint64_t> InstanceImage::GetFileStamp(
+	std::string const& filename)
+{
+	std::error_code ec;
+	std::uint64_t size = fs::file_size(filename, ec);
+	if (ec) return std::nullopt;
+	auto mtime = fs::last_write_time(filename, ec);
+	if (ec) return std::nullopt;
+	auto ticks = (std::int64_t) mtime.time_since_epoch().count();
+	auto hash = fnv1a(&size, sizeof(size));
+	return fnv1a(&ticks, sizeof(ticks), hash);
+}
+
+std::size_t InstanceImage::GetSize(Instance const& instance)
+{
+	std::lock_guard<std::mutex> lock(instance.gammaset_mutex);
+	return makeHeader(instance, instance.gammaset, instance.ordering).size;
+}
+
+bool InstanceImage::Write(Instance const& instance, std::uint64_t stamp,
+	void* buffer, std::size_t size)
+{
+	//
+	// The gamma set is stored as it is (if built at all),
+	// since another thread may replace it meanwhile
+	//
+	std::shared_ptr<ds::GammaSet const> gammaset, ordering;
+	ds::GammaSet::Strategy strategy;
+	{
+		std::lock_guard<std::mutex> lock(instance.gammaset_mutex);
+		gammaset = instance.gammaset;
+		ordering = instance.ordering;
+		strategy = instance.strategy;
+	}
+	auto h = makeHeader(instance, gammaset, ordering);
+	if (h.size > size)
+		return false; // Gamma set grown since GetSize
+	h.stamp = stamp;
+	h.strategy = (std::uint32_t) strategy;
+	auto bytes = static_cast<char*>(buffer);
+	std::memset(bytes, 0, h.size);
+	std::memcpy(bytes, &h, sizeof(header_t));
+	std::memcpy(bytes + h.name_off, instance.GetName().data(), h.name_len);
+	std::memcpy(bytes + h.comment_off, instance.GetComment().data(),
+		h.comment_len);
+	std::memcpy(bytes + h.filepath_off,
+		instance.GetSourceFilePath().data(), h.filepath_len);
+	std::memcpy(bytes + h.dmatrix_off,
+		instance.GetDistanceMatrix().data(),
+		h.dimension * h.dimension * sizeof(Dist));
+	if (h.pos_cols)
+		std::memcpy(bytes + h.posmatrix_off,
+			instance.GetPositionMatrix()->data(),
+			h.dimension * h.pos_cols * sizeof(Pos));
+	if (h.k)
+		std::memcpy(bytes + h.gammaset_off,
+			ordering->data(),
+			h.dimension * h.k * sizeof(Node));
+	return true;
+}
+
+std::optional<std::uint64_t> InstanceImage::GetStamp(void const* buffer,
+	std::size_t size)
+{
+	auto h_opt = readHeader(buffer, size);
+	if (!h_opt)
+		return std::nullopt;
+	return h_opt->stamp;
+}
+
+std::optional<std::shared_ptr<Instance>> InstanceImage::Read(
+	void const* buffer, std::size_t size, std::shared_ptr<void const> owner)
+{
+	auto h_opt = readHeader(buffer, size);
+	if (!h_opt)
+		return std::nullopt;
+	auto const& h = *h_opt;
+
+	auto bytes = static_cast<char const*>(buffer);
+
+	auto instance = std::shared_ptr<Instance>(new Instance());
+	instance->name.assign(bytes + h.name_off, h.name_len);
+	instance->comment.assign(bytes + h.comment_off, h.comment_len);
+	instance->filepath.assign(bytes + h.filepath_off, h.filepath_len);
+	instance->dimension = h.dimension;
+	instance->dmatrix = ds::SquareMatrix<Dist>::Wrap(
+		reinterpret_cast<Dist const*>(bytes + h.dmatrix_off), h.dimension,
+		owner);
+	if (h.pos_cols)
+		instance->posmatrix = ds::Matrix<Pos>::Wrap(
+			reinterpret_cast<Pos const*>(bytes + h.posmatrix_off),
+			h.dimension, h.pos_cols, owner);
+	if (h.k) {
+		instance->ordering = std::make_shared<ds::GammaSet const>(
+			reinterpret_cast<Node const*>(bytes + h.gammaset_off),
+			h.dimension, h.k, owner);
+		instance->gamma_k = h.view_k;
+		instance->strategy = (ds::GammaSet::Strategy) h.strategy;
+		instance->gammaset = std::make_shared<ds::GammaSet const>(
+			instance->ordering->View(h.view_k));
+	}
+	instance->loaded.store(true, std::memory_order_release);
+	return instance;
+}
\ No newline at end of file
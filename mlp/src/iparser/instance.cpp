@@ -1,11 +1,178 @@
 #include "instance.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
+bool Instance::RunLoader()
+{
+	bool ok = loader && loader(*this);
+	loader = nullptr; // releases the parser
+	if (!ok) {
+		dmatrix.reset();
+		posmatrix.reset();
+	}
+	return ok;
+}
+
+bool Instance::Load() const
+{
+	if (IsLoaded())
+		return dmatrix != nullptr;
+	std::shared_future<bool> future;
+	{
+		std::lock_guard<std::mutex> lock(load_mutex);
+		if (!payload.valid())
+			payload = std::async(std::launch::deferred, &Instance::RunLoader,
+				const_cast<Instance*>(this)).share();
+		future = payload;
+	}
+	bool ok = future.get();
+	loaded.store(true, std::memory_order_release);
+	return ok;
+}
+
+void Instance::Prefetch() const
+{
+	std::lock_guard<std::mutex> lock(load_mutex);
+	if (!payload.valid() && !IsLoaded())
+		payload = std::async(std::launch::async, &Instance::RunLoader,
+			const_cast<Instance*>(this)).share();
+}
+
+bool Instance::isFixed(bool changed) const
+{
+	if (shared && changed)
+		std::cerr << "Gamma set options of the shared instance " << name
+		          << " can't be changed.\n";
+	return shared;
+}
+
+void Instance::SetK(std::size_t k)
+{
+	if (isFixed(k != gamma_k))
+		return;
+	EnsureLoaded();
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	gamma_k = k;
+	if (dmatrix)
+		gammaset = std::make_shared<ds::GammaSet const>(
+			GetOrdering(k).View(k));
+}
+
+void Instance::SetMaxK(std::size_t k)
+{
+	if (isFixed(k != gamma_max_k))
+		return;
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	gamma_max_k = k;
+}
+
+void Instance::SetGammaStrategy(ds::GammaSet::Strategy strategy)
+{
+	if (isFixed(strategy != this->strategy))
+		return;
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	if (this->strategy == strategy)
+		return;
+	this->strategy = strategy;
+	ordering.reset();
+	gammaset.reset();
+}
+
+void Instance::Configure(Config const& config)
+{
+	if (isFixed(config.strategy != strategy || config.k != gamma_k))
+		return;
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	if (config.strategy != strategy)
+		ordering.reset();
+	if (config.strategy != strategy || config.k != gamma_k)
+		gammaset.reset();
+	strategy = config.strategy;
+	gamma_k = config.k;
+}
+
+Instance::Config Instance::GetConfig() const
+{
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	return { strategy, gamma_k };
+}
+
+std::shared_ptr<ds::GammaSet const> Instance::GetGammaSet() const
+{
+	EnsureLoaded();
+	std::shared_ptr<ds::GammaSet const> result;
+	{
+		std::lock_guard<std::mutex> lock(gammaset_mutex);
+		if (!gammaset && dmatrix)
+			gammaset = std::make_shared<ds::GammaSet const>(
+				GetOrdering(gamma_k).View(gamma_k));
+		result = gammaset;
+	}
+	// Outside the lock, since the hook may read the gamma set
+	if (result && on_gammaset)
+		std::call_once(on_gammaset_flag, on_gammaset, *this);
+	return result;
+}
+
+bool Instance::HasGammaSet() const
+{
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	return gammaset != nullptr;
+}
+
+std::shared_ptr<ds::GammaSet const> Instance::GetGammaSet(std::size_t k) const
+{
+	EnsureLoaded();
+	std::lock_guard<std::mutex> lock(gammaset_mutex);
+	if (!dmatrix)
+		return nullptr;
+	return std::make_shared<ds::GammaSet const>(GetOrdering(k).View(k));
+}
+
+ds::GammaSet const& Instance::GetOrdering(std::size_t k) const
+{
+	//
+	// The closest neighbours are only sorted once, up to the
+	// largest k asked for, and smaller gamma sets are views
+	// over the prefix of every row
+	//
+	k = std::min(std::max(k, gamma_max_k), dimension - 1);
+	if (!ordering || ordering->getMaxK() < k)
+		ordering = std::make_shared<ds::GammaSet const>(*this, k, threads,
+			strategy);
+	return *ordering;
+}
+
+bool Instance::HasConsistentCoordinates() const
+{
+	EnsureLoaded();
+	if (!dmatrix || !posmatrix || posmatrix->getn() != 2 ||
+		posmatrix->getm() != dimension)
+		return false;
+
+	//
+	// Checks a deterministic sample of pairs for every node
+	//
+	auto const& pos = *posmatrix;
+	std::size_t const samples = std::min<std::size_t>(dimension, 8);
+	for (Node i = 0; i < dimension; ++i)
+		for (std::size_t s = 1; s < samples; ++s) {
+			Node j = (i + s * 7919) % dimension;
+			auto dx = pos[i][0] - pos[j][0], dy = pos[i][1] - pos[j][1];
+			auto euclid = std::sqrt(dx * dx + dy * dy);
+			if (std::abs((*dmatrix)[i][j] - euclid) > 1)
+				return false;
+		}
+	return true;
+}
+
 bool Instance::IsValid() const
 {
-	if (!dmatrix) {
+	if (!Load() || !dmatrix) {
 		std::cerr << "Missing distance matrix.\n";
 		return false;
 	}
@@ -1,78 +1,232 @@
 #include "iparser.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <functional>
 #include <iostream>
+#include <string_view>
 #include <utility>
-#include <regex>
 
+#include "cache.h"
+#include "distance.h"
 #include "ds.h"
+#include "parallel.h"
 
 void matrixParsingError(std::size_t i, std::size_t j)
 {
 	std::cerr << "Error on row " << i << ", col" << j << ".\n";
 }
 
-bool buildFullMatrix(std::ifstream& fs, ds::SquareMatrix<Dist>& m) {
-	auto n = m.size();
-	for (std::size_t i = 0; i < n; ++i)
-		for (std::size_t j = 0; j < n; ++j)
-			if (!(fs >> m[i][j])) {
-				matrixParsingError(i,j);
-				return false;
-			}
-	return true;
+//
+// Layout of the entries of an EDGE_WEIGHT_SECTION
+// Row i holds the columns [first(i), last(i)), and only
+// one triangle is stored unless the matrix is full.
+//
+// Since the instances are symmetric, the column-wise formats
+// list the same entries as their row-wise counterparts
+// (e.g. UPPER_COL as LOWER_ROW).
+//
+struct ew_format_t
+{
+	std::string name;
+	bool full;
+	bool lower;
+	bool diagonal;
+
+	std::size_t first(std::size_t i) const {
+		if (full || lower) return 0;
+		return diagonal ? i : i + 1;
+	}
+
+	std::size_t last(std::size_t i, std::size_t n) const {
+		if (full || !lower) return n;
+		return diagonal ? i + 1 : i;
+	}
+
+	// Index of the first entry of row i
+	// (offset(n, n) is the number of entries)
+	std::size_t offset(std::size_t i, std::size_t n) const {
+		if (full) return i * n;
+		if (lower) return diagonal ? i * (i + 1) / 2 : i * (i - 1) / 2;
+		return (diagonal ? i * n : i * (n - 1)) - i * (i - 1) / 2;
+	}
+};
+
+const std::vector<ew_format_t> ew_formats = {
+	{ "FULL_MATRIX",    true,  false, true  },
+	{ "UPPER_ROW",      false, false, false },
+	{ "LOWER_ROW",      false, true,  false },
+	{ "UPPER_DIAG_ROW", false, false, true  },
+	{ "LOWER_DIAG_ROW", false, true,  true  },
+	{ "UPPER_COL",      false, true,  false },
+	{ "LOWER_COL",      false, false, false },
+	{ "UPPER_DIAG_COL", false, true,  true  },
+	{ "LOWER_DIAG_COL", false, false, true  },
 };
 
-bool buildLowDiagRow(std::ifstream& fs, ds::SquareMatrix<Dist>& m) {
+//
+// Reads the entries straight into the matrix,
+// mirroring them unless the matrix is full
+//
+bool buildMatrix(Tokenizer& tokens, ew_format_t const& format,
+                 ds::SquareMatrix<Dist>& m)
+{
 	auto n = m.size();
-	for (std::size_t i = 0; i < n; ++i)
-		for (std::size_t j = 0; j <= i; ++j) {
-			Dist dij;
-			if (!(fs >> dij)) {
+	for (std::size_t i = 0; i < n; ++i) {
+		auto row = m[i];
+		for (std::size_t j = format.first(i), last = format.last(i, n);
+		     j < last; ++j) {
+			if (!tokens.Next(row[j])) {
 				matrixParsingError(i, j);
 				return false;
 			}
-			m[i][j] = m[j][i] = dij;
+			if (!format.full)
+				m[j][i] = row[j];
 		}
+	}
 	return true;
-};
+}
+
+std::atomic<std::size_t> chunk_size { 1 << 18 };
 
-bool buildUpperRow(std::ifstream& fs, ds::SquareMatrix<Dist>& m) {
+//
+// Reads the entries on several threads: the section is split in
+// chunks at whitespace, the tokens of every chunk are counted,
+// and each chunk is decoded from the entry at which it starts.
+// Returns false on any error, leaving the reporting to buildMatrix.
+//
+bool buildMatrixInParallel(Tokenizer& tokens, ew_format_t const& format,
+                           ds::SquareMatrix<Dist>& m, std::size_t chunks)
+{
 	auto n = m.size();
-	for (std::size_t i = 0; i < n; ++i)
-		for (std::size_t j = i + 1; j < n; ++j) {
-			Dist dij;
-			if (!(fs >> dij)) {
-				matrixParsingError(i, j);
-				return false;
+	auto entries = format.offset(n, n);
+	auto buffer = tokens.GetBuffer();
+	auto begin = tokens.GetOffset();
+
+	//
+	// The section ends before the next keyword
+	//
+	auto end = begin;
+	while (end < buffer.size() && !std::isalpha((unsigned char) buffer[end]))
+		++end;
+
+	std::vector<std::size_t> bounds(chunks + 1);
+	bounds[0] = begin;
+	bounds[chunks] = end;
+	for (std::size_t c = 1; c < chunks; ++c) {
+		auto pos = std::max(begin + (end - begin) * c / chunks, bounds[c - 1]);
+		while (pos < end && !std::isspace((unsigned char) buffer[pos]))
+			++pos;
+		bounds[c] = pos;
+	}
+
+	//
+	// first[c] is the index of the first entry of chunk c
+	//
+	std::vector<std::size_t> first(chunks + 1, 0);
+	parallel::ForBlocks(chunks, chunks, [&] (std::size_t c0, std::size_t c1) {
+		for (auto c = c0; c < c1; ++c)
+			first[c + 1] = Tokenizer::CountTokens(
+				buffer.substr(bounds[c], bounds[c + 1] - bounds[c]));
+	});
+	for (std::size_t c = 0; c < chunks; ++c)
+		first[c + 1] += first[c];
+	if (first[chunks] < entries)
+		return false;
+
+	std::vector<char> decoded(chunks, true);
+	std::vector<std::size_t> ends(chunks, begin);
+	parallel::ForBlocks(chunks, chunks, [&] (std::size_t c0, std::size_t c1) {
+		for (auto c = c0; c < c1 && first[c] < entries; ++c) {
+			Tokenizer chunk(buffer.substr(0, bounds[c + 1]), bounds[c]);
+
+			//
+			// Last row starting at or before the first entry
+			//
+			std::size_t t = first[c], lo = 0, hi = n - 1;
+			while (lo < hi) {
+				auto mid = (lo + hi + 1) / 2;
+				if (format.offset(mid, n) <= t) lo = mid;
+				else hi = mid - 1;
 			}
-			m[i][j] = m[j][i] = dij;
+			auto i = lo;
+			auto j = format.first(i) + (t - format.offset(i, n));
+
+			for (auto last = std::min(first[c + 1], entries); t < last; ++t) {
+				while (j == format.last(i, n))
+					j = format.first(++i);
+				if (!chunk.Next(m[i][j])) {
+					decoded[c] = false;
+					break;
+				}
+				if (!format.full)
+					m[j][i] = m[i][j];
+				++j;
+			}
+			ends[c] = chunk.GetOffset();
 		}
+	});
+
+	for (std::size_t c = 0; c < chunks; ++c) {
+		if (!decoded[c])
+			return false;
+		if (first[c] < entries && entries <= first[c + 1])
+			tokens.Seek(ends[c]);
+	}
 	return true;
-};
+}
 
-using LabeledDMatrixBuilder = std::pair<std::string,
-	bool(*)(std::ifstream&, ds::SquareMatrix<Dist>&)>;
-
-const std::vector<LabeledDMatrixBuilder> ew_formats = {
-	{ "FULL_MATRIX", buildFullMatrix },
-	{ "UPPER_ROW", buildUpperRow },
-	//"LOWER_ROW",
-	//"UPPER_DIAG_ROW",
-	{ "LOWER_DIAG_ROW", buildLowDiagRow },
-	//"UPPER_COL",
-	//"LOWER_COL",
-	//"UPPER_DIAG_COL",
-	//"LOWER_DIAG_COL",
+bool is_key_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+	       (c >= '0' && c <= '9') || c == '_';
+}
+
+//
+// Entry of the file, "KEY : VALUE"
+// If the colon is missing, it means that the entry
+// is no longer for specification and it precedes
+// serialized data.
+//
+struct entry_line_t
+{
+	std::string_view key;
+	bool colon;
+	std::string_view value;
 };
 
-const std::string WHITESPACE = " \n\r\t\f\v";
+std::optional<entry_line_t> split_entry(std::string_view line)
+{
+	auto skip = [&line] (auto const& pred) {
+		std::size_t i = 0;
+		while (i < line.size() && pred(line[i]))
+			++i;
+		auto skipped = line.substr(0, i);
+		line.remove_prefix(i);
+		return skipped;
+	};
+	auto is_blank = [] (char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	};
+
+	entry_line_t entry;
+	skip(is_blank);
+	entry.key = skip(is_key_char);
+	if (entry.key.empty())
+		return std::nullopt;
+	skip(is_blank);
+	entry.colon = !line.empty() && line.front() == ':';
+	if (entry.colon)
+		line.remove_prefix(1);
+	skip(is_blank);
+	entry.value = line;
+	return entry;
+}
 
-std::string rtrim(const std::string& s)
+void InstanceParser::SetChunkSize(std::size_t entries)
 {
-	size_t end = s.find_last_not_of(WHITESPACE);
-	return (end == std::string::npos) ? "" : s.substr(0, end + 1);
+	chunk_size.store(entries);
 }
 
 SharedInstanceParser InstanceParser::Open(std::string const& filename)
@@ -81,38 +235,42 @@ SharedInstanceParser InstanceParser::Open(std::string const& filename)
 }
 
 InstanceParser::InstanceParser(std::string const& filename) :
-	filename(filename)
+	tokens(std::string_view()), filename(filename)
 {
-	fs.open(filename, std::ios::in);
+	file = FileBuffer::Open(filename);
+	if (file)
+		tokens = Tokenizer(file->View());
 }
 
-bool InstanceParser::ParseSpecification(SharedInstance& instance,
-                                        MapEntry entry)
+bool InstanceParser::ParseSpecificationEntry(Instance& instance,
+                                             MapEntry entry)
 {
 	auto& [key, value] = entry;
 	VarMapValueType entry_map_value = value;
 	if (key == "NAME") {
-		instance->name = value;
+		instance.name = value;
 	} else if (key == "TYPE") {
 		if (value != "TSP")
 			goto invalid_value;
 	} else if (key == "COMMENT") {
-		instance->comment = value;
+		instance.comment = value;
 	} else if (key == "DIMENSION") {
 		int n = stoi(value);
 		if (n <= 0)
 			return false;
 		entry_map_value = n;
 	} else if (key == "EDGE_WEIGHT_TYPE") {
-		if (value != "EXPLICIT")
+		if (!GetEdgeWeightType(value))
 			goto invalid_value;
 	} else if (key == "EDGE_WEIGHT_FORMAT") {
 		// validation will be done at ParseEdgeWeights
 	} else if (key == "NODE_COORD_TYPE") {
-		if (value != "NO_COORDS")
+		if (value != "NO_COORDS" &&
+			value != "TWOD_COORDS")
 			goto invalid_value;
 	} else if (key == "DISPLAY_DATA_TYPE") {
 		if (value != "TWOD_DISPLAY" &&
+			value != "COORD_DISPLAY" &&
 			value != "NO_DISPLAY")
 			goto invalid_value;
 	} else {
@@ -127,27 +285,9 @@ invalid_value:
 	return false;
 }
 
-bool InstanceParser::ParseDisplayData(SharedInstance& instance)
+std::shared_ptr<ds::Matrix<Pos>> InstanceParser::ReadPositions(
+	std::size_t n, std::string const& section)
 {
-	auto n_opt = GetEntryValue<int>("DIMENSION");
-	if (!n_opt) {
-		std::cerr << "Field DIMENSION not defined!\n";
-		return false;
-	}
-	auto n = *n_opt;
-
-	auto display_type_opt = GetEntryValue<std::string>("DISPLAY_DATA_TYPE");
-	if (!display_type_opt) {
-		std::cerr << "Field DISPLAY_DATA_TYPE not defined!\n";
-		return false;
-	}
-	auto display_type = *display_type_opt;
-	if (display_type != "TWOD_DISPLAY") {
-		std::cerr << "Field DISPLAY_DATA_TYPE does not support the value "
-		          << display_type << "." << std::endl;
-		return false;
-	}
-
 	int node;
 	Pos x, y;
 
@@ -164,18 +304,18 @@ bool InstanceParser::ParseDisplayData(SharedInstance& instance)
 	for (std::size_t i = 0; i < n; ++i) {
 
 		// Read node position
-		if (!(fs >> node >> x >> y)) {
+		if (!tokens.Next(node) || !tokens.Next(x) || !tokens.Next(y)) {
 			std::cerr << "Error parsing node " << node << ".\n";
-			return false;
+			return nullptr;
 		}
 
 		// number -> index
 		node--;
 
 		// Check if node is valid
-		if (node >= n || visited[node]) {
-			std::cerr << "Invalid node in DISPLAY_DATA_SECTION.\n";
-			return false;
+		if (node < 0 || node >= (int) n || visited[node]) {
+			std::cerr << "Invalid node in " << section << ".\n";
+			return nullptr;
 		}
 
 		// Store node position in matrix
@@ -186,11 +326,54 @@ bool InstanceParser::ParseDisplayData(SharedInstance& instance)
 		visited[node] = true;
 	}
 
-	instance->posmatrix = posmatrix;
+	return posmatrix;
+}
+
+bool InstanceParser::ParseNodeCoords(Instance& instance)
+{
+	auto n_opt = GetEntryValue<int>("DIMENSION");
+	if (!n_opt) {
+		std::cerr << "Field DIMENSION not defined!\n";
+		return false;
+	}
+	auto n = *n_opt;
+
+	auto coord_type_opt = GetEntryValue<std::string>("NODE_COORD_TYPE");
+	if (coord_type_opt && *coord_type_opt != "TWOD_COORDS") {
+		std::cerr << "Field NODE_COORD_TYPE does not support the value "
+		          << *coord_type_opt << "." << std::endl;
+		return false;
+	}
+
+	auto ew_type_opt = GetEntryValue<std::string>("EDGE_WEIGHT_TYPE");
+	if (!ew_type_opt) {
+		std::cerr << "Field EDGE_WEIGHT_TYPE not defined!\n";
+		return false;
+	}
+	auto ew_type = *GetEdgeWeightType(*ew_type_opt);
+
+	auto coords = ReadPositions(n, "NODE_COORD_SECTION");
+	if (!coords)
+		return false;
+
+	//
+	// Distances are computed from the coordinates,
+	// unless explicit
+	//
+	if (ew_type != EdgeWeightType::Explicit)
+		instance.dmatrix = ComputeDistanceMatrix(ew_type, *coords,
+			instance.threads);
+
+	//
+	// Nodes are displayed at their coordinates,
+	// unless there is a DISPLAY_DATA_SECTION
+	//
+	if (!instance.posmatrix)
+		instance.posmatrix = coords;
 	return true;
 }
 
-bool InstanceParser::ParseEdgeWeights(SharedInstance& instance)
+bool InstanceParser::ParseDisplayData(Instance& instance)
 {
 	auto n_opt = GetEntryValue<int>("DIMENSION");
 	if (!n_opt) {
@@ -199,6 +382,35 @@ bool InstanceParser::ParseEdgeWeights(SharedInstance& instance)
 	}
 	auto n = *n_opt;
 
+	auto display_type_opt = GetEntryValue<std::string>("DISPLAY_DATA_TYPE");
+	if (!display_type_opt) {
+		std::cerr << "Field DISPLAY_DATA_TYPE not defined!\n";
+		return false;
+	}
+	auto display_type = *display_type_opt;
+	if (display_type != "TWOD_DISPLAY") {
+		std::cerr << "Field DISPLAY_DATA_TYPE does not support the value "
+		          << display_type << "." << std::endl;
+		return false;
+	}
+
+	auto posmatrix = ReadPositions(n, "DISPLAY_DATA_SECTION");
+	if (!posmatrix)
+		return false;
+
+	instance.posmatrix = posmatrix;
+	return true;
+}
+
+bool InstanceParser::ParseEdgeWeights(Instance& instance)
+{
+	auto n_opt = GetEntryValue<int>("DIMENSION");
+	if (!n_opt) {
+		std::cerr << "Field DIMENSION not defined!\n";
+		return false;
+	}
+	auto n = (std::size_t) *n_opt;
+
 	auto ew_format_opt = GetEntryValue<std::string>("EDGE_WEIGHT_FORMAT");
 	if (!ew_format_opt) {
 		std::cerr << "Field EDGE_WEIGHT_FORMAT not defined!\n";
@@ -213,41 +425,52 @@ bool InstanceParser::ParseEdgeWeights(SharedInstance& instance)
 	for (std::size_t i = 0; i < n; ++i)
 		(*dmatrix)[i][i] = 0;
 
-	auto find_format = [ew_format] (LabeledDMatrixBuilder const& opt) {
-		return opt.first == ew_format;
+	auto find_format = [ew_format] (ew_format_t const& opt) {
+		return opt.name == ew_format;
 	};
 
 	//
-	// Find a matching matrix builder by name
+	// Find a matching matrix layout by name
 	//
-	auto builder = std::find_if(ew_formats.begin(),
-	                            ew_formats.end(),
-	                            find_format);
+	auto format = std::find_if(ew_formats.begin(),
+	                           ew_formats.end(),
+	                           find_format);
 
-	if (builder == ew_formats.end()) {
+	if (format == ew_formats.end()) {
 		std::cerr << "Unsuported EDGE_WEIGHT_FORMAT with value '"
 		          << ew_format << "'.\n";
 		return false;
 	}
 
 	//
-	// Matrix building function
+	// Large sections are decoded on several threads
 	//
-	auto buildfunc = builder->second;
+	auto entries = format->offset(n, n);
+	auto chunks = std::min(parallel::GetThreadCount(instance.threads),
+		entries / std::max(chunk_size.load(), (std::size_t) 1));
+	auto section_offset = tokens.GetOffset();
+	if (chunks > 1 &&
+		buildMatrixInParallel(tokens, *format, *dmatrix, chunks)) {
+		instance.dmatrix = dmatrix;
+		return true;
+	}
+	tokens.Seek(section_offset);
 
-	if (!buildfunc(fs, *dmatrix)) {
+	if (!buildMatrix(tokens, *format, *dmatrix)) {
 		std::cerr << "Error building matrix.\n";
 		return false;
 	}
 
-	instance->dmatrix = dmatrix;
+	instance.dmatrix = dmatrix;
 	return true;
 }
 
-bool InstanceParser::ParseData(SharedInstance& instance, std::string key)
+bool InstanceParser::ParseData(Instance& instance, std::string key)
 {
 	if (key == "DISPLAY_DATA_SECTION") {
 		return ParseDisplayData(instance);
+	} else if (key == "NODE_COORD_SECTION") {
+		return ParseNodeCoords(instance);
 	} else if (key == "EDGE_WEIGHT_SECTION") {
 		return ParseEdgeWeights(instance);
 	} else {
@@ -256,79 +479,57 @@ bool InstanceParser::ParseData(SharedInstance& instance, std::string key)
 	}
 }
 
-std::optional<bool> is_blank(std::string const& s)
+std::optional<SharedInstance> InstanceParser::Parse()
 {
-	//
-	// Pattern tha matches only whitespace characters
-	//
-	const std::regex blank_regex("^([" + WHITESPACE + "]*)$");
-
-	std::smatch match;
-
-	try {
-		return (std::regex_search(s, match, blank_regex) &&
-		       (match.size() > 1));
-	} catch (std::regex_error& e) {
-		std::cerr << "Regex error: " << e.what() << std::endl;
+	auto instance_ptr_opt = ParseSpecification();
+	if (!instance_ptr_opt || !(*instance_ptr_opt)->Load())
 		return std::nullopt;
-	}
+	return instance_ptr_opt;
 }
 
-std::optional<SharedInstance> InstanceParser::Parse()
+std::optional<SharedInstance> InstanceParser::ParseSpecification()
 {
 	//
 	// Check if the file is open
 	//
-	if (!fs.is_open()) {
+	if (!file) {
 		std::cerr << "Could not open file \"" + filename + "\"!\n";
 		return std::nullopt;
 	}
 
 	//
-	// Deserialized instance
+	// An up-to-date binary cache spares the parsing
 	//
-	auto instance_ptr = std::shared_ptr<Instance>(new Instance());
+	bool caching = InstanceCache::IsEnabled();
+	std::uint64_t stamp = 0;
+	if (caching) {
+		stamp = InstanceCache::GetStamp(file->View());
+		auto cached_opt = InstanceCache::Read(filename, stamp);
+		if (cached_opt)
+			return cached_opt;
+	}
 
 	//
-	// Current line
-	// Obtained by std::getline
+	// Deserialized instance
 	//
-	std::string line;
+	auto instance_ptr = std::shared_ptr<Instance>(new Instance());
 
 	//
-	// Flag that delimits whether in the specification
-	// section or in the data section
+	// Current line (a view over the file)
 	//
-	bool parsing_specifications = true;
+	std::string_view line;
 
 	//
-	// Pattern that matches specification entries
-	// Group 1: Entry key
-	// Group 2: Comma separator
-	// Group 3: Entry value
+	// Position of the line being parsed
 	//
-	// If the comma separator is missing, it means
-	// that the entry is no longer for specification
-	// and it precedes serialized data.
-	//
-	const std::regex entry_key_regex("([a-zA-Z0-9_]+)[ \t]*(:)?[ \t]*(.*)");
+	std::size_t line_offset;
 
 	while(true) {
 
-		//
-		// Try to obtain a non-blank line
-		// This part is necessary because when
-		// deserializing data, the file pointer
-		// might still be on the end of a line
-		//
-		while(true) {
-			std::getline(fs, line);
-			auto is_blank_opt = is_blank(line);
-			if (!is_blank_opt)
-				goto error;
-			auto is_blank = *is_blank_opt;
-			if (!is_blank)
-				break;
+		line_offset = tokens.GetOffset();
+		if (!tokens.NextLine(line)) {
+			std::cerr << "Unexpected end of file.\n";
+			goto parsing_error;
 		}
 
 		//
@@ -337,49 +538,93 @@ std::optional<SharedInstance> InstanceParser::Parse()
 		if (line == "EOF")
 			break;
 
-		try {
-			std::smatch match;
+		auto entry_opt = split_entry(line);
+		if (!entry_opt) {
+			std::cerr << "Invalid entry.\n";
+			goto parsing_error;
+		}
+		auto const& entry = *entry_opt;
+		if (!entry.colon) {
 
 			//
-			// Try to match the regex against the line
+			// Matched data section entry
+			// It is parsed later, on demand
 			//
-			if (std::regex_search(line, match, entry_key_regex)
-				&& match.size() > 3) {
-				std::string key   = match[1],
-					        colon = match[2],
-					        value = rtrim(match[3]);
-				if (colon.empty()) {
-
-					//
-					// Matched data section entry
-					//
-					parsing_specifications = false;
-					if (!ParseData(instance_ptr, key)) {
-						std::cerr << "Error parsing data.\n";
-						goto parsing_error;
-					}
-				} else if (parsing_specifications) {
-
-					//
-					// Matched specification entry
-					//
-					auto entry = std::make_pair(key, value);
-					if (!ParseSpecification(instance_ptr, entry)) {
-						std::cerr << "Error parsing specification.\n";
-						goto parsing_error;
-					}
-				} else {
-					std::cerr << "Corrupted file: specification found"
-					             " in the data section.\n";
-					goto parsing_error;
-				}
-			} else {
-				std::cerr << "Did not match regex.\n";
-				goto parsing_error;
-			}
-		} catch (std::regex_error& e) {
-			std::cerr << "Regex error: " << e.what() << std::endl;
-			goto error;
+			break;
+		}
+
+		//
+		// Matched specification entry
+		//
+		auto map_entry = std::make_pair(std::string(entry.key),
+			std::string(entry.value));
+		if (!ParseSpecificationEntry(*instance_ptr, map_entry)) {
+			std::cerr << "Error parsing specification.\n";
+			goto parsing_error;
+		}
+	}
+
+	{
+		auto n_opt = GetEntryValue<int>("DIMENSION");
+		if (!n_opt) {
+			std::cerr << "Field DIMENSION not defined!\n";
+			return std::nullopt;
+		}
+		instance_ptr->dimension = *n_opt;
+	}
+
+	data_offset = line_offset;
+	instance_ptr->filepath = filename;
+	instance_ptr->loader = [self = shared_from_this()] (Instance& instance) {
+		return self->ParseDataSections(instance);
+	};
+	if (caching)
+		instance_ptr->on_gammaset = [stamp] (Instance const& instance) {
+			InstanceCache::Write(instance, stamp);
+		};
+
+	return instance_ptr;
+
+parsing_error:
+	std::cerr << "Last entry parsed: \"" << line << "\".\n";
+	return std::nullopt;
+}
+
+bool InstanceParser::ParseDataSections(Instance& instance)
+{
+	//
+	// Current line (a view over the file)
+	//
+	std::string_view line;
+
+	tokens.Seek(data_offset);
+
+	while(true) {
+
+		//
+		// The token 'EOF' (or the end of the file itself)
+		// determines the end of the file
+		//
+		if (!tokens.NextLine(line) || line == "EOF")
+			break;
+
+		auto entry_opt = split_entry(line);
+		if (!entry_opt) {
+			std::cerr << "Invalid entry.\n";
+			goto parsing_error;
+		}
+		if (entry_opt->colon) {
+			std::cerr << "Corrupted file: specification found"
+			             " in the data section.\n";
+			goto parsing_error;
+		}
+
+		//
+		// Matched data section entry
+		//
+		if (!ParseData(instance, std::string(entry_opt->key))) {
+			std::cerr << "Error parsing data.\n";
+			goto parsing_error;
 		}
 	}
 
@@ -387,18 +632,15 @@ std::optional<SharedInstance> InstanceParser::Parse()
 	// In a ill-formed file, a distance matrix might
 	// not have been defined.
 	//
-	if (!instance_ptr->dmatrix) {
+	if (!instance.dmatrix) {
 		std::cerr << "Distance matrix not defined.\n";
-		return std::nullopt;
+		return false;
 	}
 
-	instance_ptr->filepath = filename;
-	instance_ptr->SetK(50);
-
-	return instance_ptr;
+	return true;
 
 parsing_error:
 	std::cerr << "Last entry parsed: \"" << line << "\".\n";
-error:
-	return std::nullopt;
+	std::cerr << "Error parsing instance \"" << filename << "\".\n";
+	return false;
 }
\ No newline at end of file
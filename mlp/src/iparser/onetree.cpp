@@ -0,0 +1,190 @@
+#include "onetree.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "instance.h"
+
+using namespace ds;
+
+OneTree::OneTree(Instance const& instance, std::vector<double> pi) :
+	instance(&instance), n(instance.GetSize()), pi(std::move(pi)),
+	dad(n), degree(n, 0), special(0)
+{
+	if (this->pi.empty())
+		this->pi.assign(n, 0);
+
+	//
+	// Prim's algorithm over every node but the special one,
+	// O(n^2) since the graph is complete
+	//
+	auto const infinity = std::numeric_limits<double>::infinity();
+	std::vector<double> key(n, infinity);
+	std::vector<bool> in_tree(n, false);
+	in_tree[special] = true;
+	Node root = special == 0 ? 1 : 0;
+	key[root] = 0;
+	dad[root] = root;
+	double length = 0;
+	order.reserve(n - 1);
+	Node u = root;
+	for (std::size_t added = 0; added + 1 < n; ++added) {
+		in_tree[u] = true;
+		order.push_back(u);
+		if (u != root) {
+			length += key[u];
+			++degree[u];
+			++degree[dad[u]];
+		}
+
+		//
+		// Updates the keys from u while looking for
+		// the next node to add
+		//
+		auto const* du = instance[u];
+		auto const pu = this->pi[u];
+		Node next = n;
+		for (Node j = 0; j < n; ++j) {
+			if (in_tree[j])
+				continue;
+			auto c = du[j] + pu + this->pi[j];
+			if (c < key[j]) {
+				key[j] = c;
+				dad[j] = u;
+			}
+			if (next == n || key[j] < key[next])
+				next = j;
+		}
+		u = next;
+	}
+	dad[special] = special;
+
+	//
+	// The two cheapest edges of the special node
+	//
+	first = second = n;
+	for (Node j = 0; j < n; ++j) {
+		if (j == special)
+			continue;
+		auto c = getCost(special, j);
+		if (first == n || c < getCost(special, first)) {
+			second = first;
+			first = j;
+		} else if (second == n || c < getCost(special, second)) {
+			second = j;
+		}
+	}
+	length += getCost(special, first) + getCost(special, second);
+	degree[special] = 2;
+	++degree[first];
+	++degree[second];
+
+	lower_bound = length;
+	for (auto const& p : this->pi)
+		lower_bound -= 2 * p;
+}
+
+double OneTree::getCost(Node i, Node j) const
+{
+	return (*instance)[i][j] + pi[i] + pi[j];
+}
+
+bool OneTree::isTour() const
+{
+	return std::all_of(degree.begin(), degree.end(),
+		[] (int d) { return d == 2; });
+}
+
+void OneTree::computeAlphas(Node i, std::vector<double>& alphas,
+	std::vector<double>& beta, std::vector<Node>& mark) const
+{
+	alphas.resize(n);
+	auto special_alpha = [&] (Node j) {
+		if (j == first || j == second)
+			return 0.0;
+		return getCost(special, j) - getCost(special, second);
+	};
+
+	if (i == special) {
+		for (Node j = 0; j < n; ++j)
+			alphas[j] = j == special ? 0 : special_alpha(j);
+		return;
+	}
+
+	//
+	// beta[j] is the cost of the most expensive edge on the tree
+	// path from i to j (Helsgaun, 2000). It is first computed
+	// along the path from i to the root, then for every other
+	// node from its parent, in topological order.
+	//
+	beta.resize(n);
+	mark.resize(n);
+	auto const stamp = i + 1;
+	beta[i] = -std::numeric_limits<double>::infinity();
+	mark[i] = stamp;
+	for (Node k = i; dad[k] != k; k = dad[k]) {
+		beta[dad[k]] = std::max(beta[k], getCost(k, dad[k]));
+		mark[dad[k]] = stamp;
+	}
+	for (auto const& j : order) {
+		if (mark[j] != stamp)
+			beta[j] = std::max(beta[dad[j]], getCost(j, dad[j]));
+		alphas[j] = j == i ? 0 : getCost(i, j) - beta[j];
+	}
+	alphas[special] = special_alpha(i);
+}
+
+std::vector<double> OneTree::Ascent(Instance const& instance)
+{
+	auto const n = instance.GetSize();
+	std::vector<double> pi(n, 0), best_pi = pi;
+	OneTree tree(instance, pi);
+	double best = tree.getLowerBound();
+	if (tree.isTour())
+		return best_pi;
+
+	//
+	// Step size and period schedule of LKH: the step doubles
+	// while the bound improves in the initial phase, and the
+	// step and the period are halved after every period
+	//
+	auto degreeOf = [&] (OneTree const& t) {
+		std::vector<int> v(n);
+		for (Node i = 0; i < n; ++i)
+			v[i] = t.degree[i] - 2;
+		return v;
+	};
+	auto v = degreeOf(tree), last_v = v;
+	double step = 1;
+	std::size_t period = std::max(n / 2, (std::size_t) 100);
+	bool initial_phase = true;
+
+	while (period > 0 && step > 1e-3) {
+		for (std::size_t p = 0; p < period && step > 1e-3; ++p) {
+			for (Node i = 0; i < n; ++i)
+				pi[i] += step * (0.7 * v[i] + 0.3 * last_v[i]);
+			tree = OneTree(instance, pi);
+			last_v = v;
+			v = degreeOf(tree);
+			auto bound = tree.getLowerBound();
+			if (bound > best) {
+				best = bound;
+				best_pi = pi;
+				if (tree.isTour())
+					return best_pi;
+				if (initial_phase)
+					step *= 2;
+				if (p == period - 1)
+					period *= 2;
+			} else if (initial_phase && p > period / 2) {
+				initial_phase = false;
+				p = 0;
+				step = 3 * step / 4;
+			}
+		}
+		period /= 2;
+		step /= 2;
+		initial_phase = false;
+	}
+	return best_pi;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "registry.h"
+
+#include <filesystem>
+
+#include "image.h"
+#include "iparser.h"
+
+namespace fs = std::filesystem;
+
+std::shared_ptr<InstanceRegistry> InstanceRegistry::instance =
+	std::shared_ptr<InstanceRegistry>(new InstanceRegistry());
+
+std::shared_ptr<InstanceRegistry> InstanceRegistry::GetInstance()
+{
+	return instance;
+}
+
+std::optional<std::shared_ptr<Instance>> InstanceRegistry::Get(
+	std::string const& filename)
+{
+	Instance::Config config;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		config = default_config;
+	}
+	return Get(filename, config);
+}
+
+std::optional<std::shared_ptr<Instance>> InstanceRegistry::Get(
+	std::string const& filename, Instance::Config const& config)
+{
+	std::error_code ec;
+	auto path = fs::canonical(filename, ec).string();
+	auto stamp_opt = InstanceImage::GetFileStamp(filename);
+	if (ec || !stamp_opt) {
+		// Let the parser report the error
+		return InstanceParser::Open(filename)->ParseSpecification();
+	}
+	auto key = std::make_pair(path, config);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto entry = entries.find(key);
+	if (entry != entries.end()) {
+		auto instance = entry->second.instance.lock();
+		if (instance && entry->second.stamp == *stamp_opt)
+			return instance;
+		entries.erase(entry); // outdated, or released
+	}
+
+	// Entries of released instances are dropped along
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (it->second.instance.expired())
+			it = entries.erase(it);
+		else
+			++it;
+	}
+
+	auto instance_opt = InstanceParser::Open(filename)->ParseSpecification();
+	if (instance_opt) {
+		auto& instance = **instance_opt;
+		instance.Configure(config);
+		instance.shared = true;
+		entries[key] = entry_t{ *stamp_opt, *instance_opt };
+	}
+	return instance_opt;
+}
+
+void InstanceRegistry::SetDefaultConfig(Instance::Config const& config)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	default_config = config;
+}
+
+void InstanceRegistry::Remove(std::string const& filename)
+{
+	std::error_code ec;
+	auto path = fs::canonical(filename, ec).string();
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto entry = entries.begin(); entry != entries.end();) {
+		if (entry->first.first == path)
+			entry = entries.erase(entry);
+		else
+			++entry;
+	}
+}
+
+void InstanceRegistry::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+}
\ No newline at end of file
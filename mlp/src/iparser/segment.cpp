@@ -0,0 +1,256 @@
+#include "segment.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+
+#include "image.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SEGMENT_SUPPORTED
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	//
+	// Segment layout:
+	// [control block][padding][instance image]
+	//
+	struct control_t
+	{
+		std::atomic<std::uint32_t> state;
+		std::atomic<std::uint32_t> owner; // pid of the publisher
+	};
+
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+		"Segment control block must be address-free");
+
+	constexpr std::size_t image_offset = 64;
+	constexpr std::uint32_t segment_ready = 1;
+
+	//
+	// Maximum time waited for a segment that is
+	// still being published by another process
+	//
+	constexpr auto publish_timeout = std::chrono::seconds(30);
+	constexpr auto publish_poll = std::chrono::milliseconds(10);
+
+	std::uint64_t fnv1a(void const* data, std::size_t size,
+		std::uint64_t hash = 14695981039346656037ull)
+	{
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+std::optional<std::string> InstanceSegment::GetName(
+	std::string const& filename)
+{
+	std::error_code ec;
+	auto path = fs::canonical(filename, ec).string();
+	if (ec) return std::nullopt;
+	std::ostringstream name;
+	name << "/mlp." << std::hex << fnv1a(path.data(), path.size());
+	return name.str();
+}
+
+#ifdef SEGMENT_SUPPORTED
+
+namespace
+{
+	//
+	// Whether the segment is still not ready, but its publisher
+	// died (e.g. crashed while writing it), so it never will be
+	//
+	bool isAbandoned(control_t const& control)
+	{
+		if (control.state.load(std::memory_order_acquire) == segment_ready)
+			return false;
+		auto owner = (pid_t) control.owner.load(std::memory_order_acquire);
+		return owner != 0 && kill(owner, 0) != 0 && errno == ESRCH;
+	}
+
+	//
+	// Unlinks the segment if abandoned
+	// Returns whether it was
+	//
+	bool removeIfAbandoned(std::string const& name)
+	{
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		bool abandoned = false;
+		if (fstat(fd, &st) == 0 && (std::size_t) st.st_size > image_offset) {
+			void* addr = mmap(nullptr, sizeof(control_t), PROT_READ,
+				MAP_SHARED, fd, 0);
+			if (addr != MAP_FAILED) {
+				abandoned = isAbandoned(*static_cast<control_t const*>(addr));
+				munmap(addr, sizeof(control_t));
+			}
+		}
+		close(fd);
+		if (abandoned)
+			shm_unlink(name.c_str());
+		return abandoned;
+	}
+}
+
+std::optional<std::shared_ptr<Instance>> InstanceSegment::Attach(
+	std::string const& filename)
+{
+	auto name_opt = GetName(filename);
+	auto stamp_opt = InstanceImage::GetFileStamp(filename);
+	if (!name_opt || !stamp_opt)
+		return std::nullopt;
+	auto const& name = *name_opt;
+
+	auto const deadline = std::chrono::steady_clock::now() + publish_timeout;
+
+	while (true) {
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return std::nullopt; // Not published
+
+		struct stat st;
+		std::size_t size = 0;
+		if (fstat(fd, &st) == 0)
+			size = (std::size_t) st.st_size;
+
+		//
+		// The segment might have been created,
+		// but not yet truncated to its final size
+		//
+		if (size > image_offset) {
+			void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (addr == MAP_FAILED) {
+				std::cerr << "Could not map segment " << name << ".\n";
+				return std::nullopt;
+			}
+			auto owner = std::shared_ptr<void const>(addr,
+				[size] (void const* p) { munmap(const_cast<void*>(p), size); });
+			auto control = static_cast<control_t const*>(addr);
+			if (control->state.load(std::memory_order_acquire) == segment_ready) {
+				auto image = static_cast<char const*>(addr) + image_offset;
+				auto image_size = size - image_offset;
+				auto stamp_opt_ = InstanceImage::GetStamp(image, image_size);
+				if (!stamp_opt_ || *stamp_opt_ != *stamp_opt) {
+					std::cerr << "Segment " << name << " is out of date.\n";
+					Remove(filename);
+					return std::nullopt;
+				}
+				return InstanceImage::Read(image, image_size, owner);
+			}
+			if (isAbandoned(*control)) {
+				std::cerr << "Segment " << name << " was abandoned by its "
+				             "publisher, and is published again.\n";
+				Remove(filename);
+				return std::nullopt;
+			}
+		} else {
+			close(fd);
+		}
+
+		//
+		// Also the case of a publisher that died before
+		// writing its pid
+		//
+		if (std::chrono::steady_clock::now() > deadline) {
+			std::cerr << "Timed out waiting for segment " << name
+			          << ", which is published again.\n";
+			Remove(filename);
+			return std::nullopt;
+		}
+
+		std::this_thread::sleep_for(publish_poll);
+	}
+}
+
+bool InstanceSegment::Publish(Instance const& instance)
+{
+	auto const& filename = instance.GetSourceFilePath();
+	auto name_opt = GetName(filename);
+	auto stamp_opt = InstanceImage::GetFileStamp(filename);
+	if (!name_opt || !stamp_opt)
+		return false;
+	auto const& name = *name_opt;
+
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0 && errno == EEXIST && removeIfAbandoned(name))
+		fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		if (errno != EEXIST)
+			std::cerr << "Could not create segment " << name << ".\n";
+		return false;
+	}
+
+	auto size = image_offset + InstanceImage::GetSize(instance);
+	void* addr = MAP_FAILED;
+	if (ftruncate(fd, (off_t) size) == 0)
+		addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		std::cerr << "Could not map segment " << name << ".\n";
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	auto control = new (addr) control_t{};
+	control->owner.store((std::uint32_t) getpid(), std::memory_order_release);
+	bool written = InstanceImage::Write(instance, *stamp_opt,
+		static_cast<char*>(addr) + image_offset, size - image_offset);
+	if (written)
+		control->state.store(segment_ready, std::memory_order_release);
+	else
+		shm_unlink(name.c_str());
+	munmap(addr, size);
+	return written;
+}
+
+bool InstanceSegment::Remove(std::string const& filename)
+{
+	auto name_opt = GetName(filename);
+	if (!name_opt)
+		return false;
+	return shm_unlink(name_opt->c_str()) == 0;
+}
+
+#else
+
+std::optional<std::shared_ptr<Instance>> InstanceSegment::Attach(
+	std::string const& filename)
+{
+	return std::nullopt;
+}
+
+bool InstanceSegment::Publish(Instance const& instance)
+{
+	std::cerr << "Shared memory segments are not supported.\n";
+	return false;
+}
+
+bool InstanceSegment::Remove(std::string const& filename)
+{
+	return false;
+}
+
+#endif
\ No newline at end of file
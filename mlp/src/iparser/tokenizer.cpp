@@ -0,0 +1,100 @@
+#include "tokenizer.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MMAP_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	bool is_whitespace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' ||
+		       c == '\t' || c == '\f' || c == '\v';
+	}
+}
+
+std::shared_ptr<FileBuffer const> FileBuffer::Open(std::string const& filename)
+{
+	auto file = std::shared_ptr<FileBuffer>(new FileBuffer());
+
+#ifdef MMAP_SUPPORTED
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			madvise(addr, st.st_size, MADV_SEQUENTIAL);
+			file->data = static_cast<char const*>(addr);
+			file->size = st.st_size;
+			file->mapped = true;
+		}
+	}
+	close(fd);
+	if (file->mapped)
+		return file;
+#endif
+
+	//
+	// Reads the whole file at once
+	//
+	std::ifstream fs(filename, std::ios::in | std::ios::binary);
+	if (!fs.is_open())
+		return nullptr;
+	file->contents.assign(std::istreambuf_iterator<char>(fs),
+		std::istreambuf_iterator<char>());
+	file->data = file->contents.data();
+	file->size = file->contents.size();
+	return file;
+}
+
+FileBuffer::~FileBuffer()
+{
+#ifdef MMAP_SUPPORTED
+	if (mapped)
+		munmap(const_cast<char*>(data), size);
+#endif
+}
+
+bool Tokenizer::NextLine(std::string_view& line)
+{
+	while (offset < buffer.size()) {
+		auto end = buffer.find('\n', offset);
+		if (end == std::string_view::npos)
+			end = buffer.size();
+		line = buffer.substr(offset, end - offset);
+		offset = end < buffer.size() ? end + 1 : end;
+
+		while (!line.empty() && is_whitespace(line.back()))
+			line.remove_suffix(1);
+		if (!line.empty())
+			return true;
+	}
+	return false;
+}
+
+void Tokenizer::SkipWhitespace()
+{
+	while (offset < buffer.size() && is_whitespace(buffer[offset]))
+		++offset;
+}
+
+std::size_t Tokenizer::CountTokens(std::string_view buffer)
+{
+	std::size_t count = 0;
+	bool in_token = false;
+	for (auto const& c : buffer) {
+		bool blank = is_whitespace(c);
+		count += !blank && !in_token;
+		in_token = !blank;
+	}
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// Range of the block 'b' out of 'blocks' blocks covering [0, n)
+	std::pair<std::size_t, std::size_t> blockRange(std::size_t n,
+		std::size_t blocks, std::size_t b)
+	{
+		auto const block = n / blocks, remainder = n % blocks;
+		auto begin = b * block + std::min(b, remainder);
+		return { begin, begin + block + (b < remainder) };
+	}
+}
+
+std::size_t parallel::GetThreadCount(std::size_t threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	return std::max(threads, (std::size_t) 1);
+}
+
+void parallel::ForBlocks(std::size_t n, std::size_t threads,
+	std::function<void(std::size_t, std::size_t)> const& f)
+{
+	threads = std::min(GetThreadCount(threads), n);
+	if (threads <= 1) {
+		if (n > 0) f(0, n);
+		return;
+	}
+
+	//
+	// The calling thread takes the first block
+	//
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (std::size_t t = 1; t < threads; ++t) {
+		auto [begin, end] = blockRange(n, threads, t);
+		workers.emplace_back(f, begin, end);
+	}
+	auto [begin, end] = blockRange(n, threads, 0);
+	f(begin, end);
+	for (auto& worker : workers)
+		worker.join();
+}
+
+parallel::ThreadPool::ThreadPool(std::size_t threads)
+{
+	threads = parallel::GetThreadCount(threads);
+	workers.reserve(threads - 1);
+	for (std::size_t t = 1; t < threads; ++t)
+		workers.emplace_back(&ThreadPool::work, this, t);
+}
+
+parallel::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+std::size_t parallel::ThreadPool::GetThreadCount() const
+{
+	return workers.size() + 1;
+}
+
+void parallel::ThreadPool::ForBlocks(std::size_t n,
+	std::function<void(std::size_t, std::size_t)> const& f)
+{
+	auto const blocks = std::min(GetThreadCount(), n);
+	if (blocks <= 1) {
+		if (n > 0) f(0, n);
+		return;
+	}
+
+	//
+	// Every worker wakes up for a new generation,
+	// and only the ones with a block do some work
+	//
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &f;
+		task_n = n;
+		task_blocks = blocks;
+		pending = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+	auto [begin, end] = blockRange(n, blocks, 0);
+	f(begin, end);
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return pending == 0; });
+	task = nullptr;
+}
+
+void parallel::ThreadPool::work(std::size_t id)
+{
+	std::size_t seen = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait(lock, [&] { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+		auto const* f = task;
+		auto const n = task_n, blocks = task_blocks;
+		lock.unlock();
+		if (id < blocks) {
+			auto [begin, end] = blockRange(n, blocks, id);
+			(*f)(begin, end);
+		}
+		lock.lock();
+		if (--pending == 0)
+			done.notify_one();
+	}
+}
\ No newline at end of file
@@ -25,6 +25,8 @@ PopulationStatus Genetic::explore(StoppingCriterion stopping_criterion)
 	while (!stopping_criterion(status)) {
 
 		p->DoNextGeneration();
+		status.generation_stats = p->GetGenerationStats();
+		AccumulateStats(status.total_stats, status.generation_stats);
 
 		auto const& best_solution = p->GetBestSolution();
 		auto curr_best_cost = p->GetSolutionCost(best_solution);
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <cassert>
 #include <algorithm>
+#include <array>
+#include <memory_resource>
 #include <random>
 #include <set>
 
@@ -15,6 +17,8 @@ Population::Population(
 	std::size_t window,
 	unsigned int seed) :
 
+	solution_pool(std::make_shared<std::pmr::synchronized_pool_resource>()),
+	scratch_pool(std::make_shared<std::pmr::unsynchronized_pool_resource>()),
 	instance_ptr(instance_ptr),
 	minSize(minSize),
 	maxSize(maxSize),
@@ -27,16 +31,21 @@ Population::Population(
 	mutation_chance(1)
 {
 	for (std::size_t i = 0; i < minSize; ++i)
-		AddSolution(std::make_shared<Solution>(instance_ptr, window, rng));
+		AddSolution(std::make_shared<Solution>(instance_ptr, window, rng,
+			solution_pool));
 }
 
 void Population::DoNextGeneration()
 {
 	auto const nparents = size();
+	/* SCRATCH MEMORY, GIVEN BACK TO THE POOL AT THE END */
+	std::pmr::monotonic_buffer_resource arena(scratch_pool.get());
+	ResetStats(generation_stats);
 	/* PARENT SELECTION THROUGH BINARY TOURNAMENT */
-	std::vector<std::shared_ptr<Solution>> matingPool;
+	std::pmr::vector<std::shared_ptr<Solution>> matingPool(&arena);
+	matingPool.reserve(matingPoolSize);
 	for (std::size_t i = 0; i < matingPoolSize; ++i) {
-		std::vector<std::shared_ptr<Solution>> btourn(2);
+		std::array<std::shared_ptr<Solution>, 2> btourn;
 		std::sample(begin(), end(), btourn.begin(), 2, rng);
 		bool firstIsBetter = cost_map.at(btourn[0]) < cost_map.at(btourn[1]);
 		matingPool.push_back(btourn[firstIsBetter ? 0 : 1]);
@@ -55,11 +64,10 @@ void Population::DoNextGeneration()
 			double p = unif(rng);
 			auto n = offspring->GetInstance()->GetSize();
 			auto perturbationSize = std::max((std::size_t) (n * p), (std::size_t) 1);
-			LocalSearch ls(rng);
-			/* PERTURBATION */
-			ls.perturbSolution(*offspring, perturbationSize);
-			/* LOCAL SEARCH */
-			ls.findLocalMinimum(*offspring);
+			if (ls_chains)
+				mutate<ChainLocalSearch>(*offspring, perturbationSize);
+			else
+				mutate<LocalSearch>(*offspring, perturbationSize);
 		}
 		/* ADD OFFSPRING */
 		AddSolution(offspring);
@@ -67,7 +75,7 @@ void Population::DoNextGeneration()
 	/* OVERFLOW CHECK */
 	if (size() > maxSize) {
 		/* REMOVAL OF CLONES */
-		std::set<std::size_t, std::greater<std::size_t>> clone_indexes;
+		std::pmr::set<std::size_t, std::greater<std::size_t>> clone_indexes(&arena);
 		for (std::size_t i = 0; i < size(); ++i)
 			for (std::size_t j = i + 1; j < size(); ++j)
 				if (*at(i) == *at(j))
@@ -80,9 +88,9 @@ void Population::DoNextGeneration()
 				return (a != b && cost_map.at(at(a)) > cost_map.at(at(b)))
 					|| (a == b && at(a)->GetId() < at(b)->GetId());
 			};
-			std::set<std::size_t, decltype(order)> ranking(order);
+			std::pmr::set<std::size_t, decltype(order)> ranking(order, &arena);
 			for (std::size_t i = 0; i < size(); ++i) ranking.insert(i);
-			std::set<std::size_t, std::greater<std::size_t>> worse_indexes;
+			std::pmr::set<std::size_t, std::greater<std::size_t>> worse_indexes(&arena);
 			for (auto const& index : ranking) {
 				if (size() - worse_indexes.size() <= minSize)
 					break;
@@ -130,6 +138,59 @@ void Population::SetMutationChance(double chance)
 	this->mutation_chance = chance;
 }
 
+void Population::SetNeighbourhoodOrder(LocalSearch::Order order)
+{
+	this->ls_order = order;
+}
+
+void Population::SetDescent(LocalSearch::Descent descent, std::size_t threads)
+{
+	this->ls_descent = descent;
+	this->ls_pool.reset();
+	if (descent == LocalSearch::Descent::BestImprovement &&
+		parallel::GetThreadCount(threads) > 1)
+		this->ls_pool = std::make_shared<parallel::ThreadPool>(threads);
+}
+
+void Population::SetPerturbation(LocalSearch::Perturbation perturbation)
+{
+	this->ls_perturbation = perturbation;
+	// Shared by the mutations, so that it learns across generations
+	this->perturbation_bandit.reset();
+	if (perturbation == LocalSearch::Perturbation::Bandit)
+		this->perturbation_bandit =
+			std::make_shared<LocalSearch::PerturbationBandit>();
+}
+
+// Perturbation and local search of an offspring
+template<class Search>
+void Population::mutate(Solution& offspring, std::size_t perturbationSize)
+{
+	Search ls(rng);
+	ls.SetScratchResource(scratch_pool);
+	ls.SetNeighbourhoodOrder(ls_order);
+	ls.SetDescent(ls_descent, ls_pool);
+	ls.SetPerturbation(ls_perturbation);
+	ls.SetPerturbationBandit(perturbation_bandit);
+	Cost cost = offspring.GetCost();
+	/* PERTURBATION */
+	ls.perturbSolution(offspring, perturbationSize);
+	/* LOCAL SEARCH */
+	ls.findLocalMinimum(offspring);
+	ls.RewardPerturbation(cost - offspring.GetCost());
+	AccumulateStats(generation_stats, ls.GetStats());
+}
+
+void Population::SetEjectionChains(bool enabled)
+{
+	this->ls_chains = enabled;
+}
+
+SearchStats const& Population::GetGenerationStats() const
+{
+	return generation_stats;
+}
+
 void Population::SetVerbosity(bool isVerbose)
 {
 	this->verbose = isVerbose;
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <memory_resource>
 
 #include "ls.h"
 
@@ -15,8 +16,32 @@ IterationStatus IteratedLocalSearch::explore (Solution const& initial_solution,
                                        unsigned long long ils_decay_factor,
                                        StoppingCriterion stopping_criterion)
 {
-	LocalSearch ls(seed);
-	auto solution = std::make_shared<Solution>(initial_solution);
+	if (ejection_chains)
+		return search<ChainLocalSearch>(initial_solution, perturbation,
+			ils_decay_factor, stopping_criterion);
+	return search<LocalSearch>(initial_solution, perturbation,
+		ils_decay_factor, stopping_criterion);
+}
+
+template<class Search>
+IterationStatus IteratedLocalSearch::search (Solution const& initial_solution,
+                                      double perturbation,
+                                      unsigned long long ils_decay_factor,
+                                      StoppingCriterion stopping_criterion)
+{
+	Search ls(seed);
+	ls.SetNeighbourhoodOrder(order);
+	ls.SetPerturbation(perturbation_type);
+	if (descent == LocalSearch::Descent::BestImprovement &&
+		parallel::GetThreadCount(threads) > 1)
+		ls.SetDescent(descent, std::make_shared<parallel::ThreadPool>(threads));
+	else
+		ls.SetDescent(descent);
+
+	// Solutions of the search share a pool, and the best one is
+	// overwritten in place, so that improvements do not allocate
+	auto resource = std::make_shared<std::pmr::synchronized_pool_resource>();
+	auto solution = std::make_shared<Solution>(initial_solution, resource);
 
 	double initial_perturbation = perturbation;
 	std::size_t n = solution->GetInstance()->GetSize();
@@ -30,21 +55,45 @@ IterationStatus IteratedLocalSearch::explore (Solution const& initial_solution,
 	auto const t_start = std::chrono::steady_clock::now();
 	auto t_last_improvement = t_start;
 
-	IterationStatus status { bestSolution };
+	IterationStatus status {};
+	status.solution = bestSolution;
 
 	status.perturbationSize = perturbationSize;
+	status.iteration_stats = ls.GetStats();
+	AccumulateStats(status.total_stats, status.iteration_stats);
+
+	std::vector<Node> touched_nodes;
+
+	// Reoptimizes windows, and descends from the improved ones,
+	// until every window is optimal
+	auto polish = [&](Solution& s) {
+		touched_nodes.clear();
+		while (ls.reoptimizeWindows(s, window_size, &touched_nodes) > 0) {
+			ls.findLocalMinimum(s, &touched_nodes);
+			touched_nodes.clear();
+		}
+	};
+	unsigned long long iteration_cnt = 0;
 
 	while (!stopping_criterion(status)) {
 
-		ls.perturbSolution(*solution, perturbationSize);
-		ls.findLocalMinimum(*solution);
+		auto const prevCost = currCost;
+		touched_nodes.clear();
+		ls.perturbSolution(*solution, perturbationSize, &touched_nodes);
+		ls.ResetStats();
+		ls.findLocalMinimum(*solution, &touched_nodes);
+		if (window_size && window_period && ++iteration_cnt % window_period == 0)
+			polish(*solution);
 		currCost = solution->GetCost();
+		ls.RewardPerturbation(prevCost - currCost);
+		status.iteration_stats = ls.GetStats();
+		AccumulateStats(status.total_stats, status.iteration_stats);
 
 		auto const t_now = std::chrono::steady_clock::now();
 
 		if (bestCost > currCost) {
 			t_last_improvement = t_now;
-			bestSolution = std::make_shared<Solution>(*solution);
+			*bestSolution = *solution;
 			bestCost = currCost;
 			status.t_last_improvement = 0;
 			status.iteration_id = 0;
@@ -70,5 +119,11 @@ IterationStatus IteratedLocalSearch::explore (Solution const& initial_solution,
 		}
 	}
 
+	if (window_size) {
+		ls.ResetStats();
+		polish(*bestSolution);
+		AccumulateStats(status.total_stats, ls.GetStats());
+	}
+
 	return status;
 }
@@ -2,134 +2,67 @@
 
 #include <iostream>
 #include <algorithm>
+#include <bitset>
+#include <limits>
+#include <tuple>
 
-LocalSearch::LocalSearch(std::default_random_engine& rng)
+template class BasicLocalSearch<DefaultPipeline>;
+template class BasicLocalSearch<ChainPipeline>;
+
+LocalSearchBase::LocalSearchBase(std::default_random_engine& rng) :
+	scratch(std::make_shared<std::pmr::unsynchronized_pool_resource>())
 {
 	this->rng = rng;
 }
 
-LocalSearch::LocalSearch(unsigned int seed)
+LocalSearchBase::LocalSearchBase(unsigned int seed) :
+	scratch(std::make_shared<std::pmr::unsynchronized_pool_resource>())
 {
 	rng = std::default_random_engine(seed);
 }
 
-struct ls_state
+void LocalSearchBase::SetScratchResource(
+	std::shared_ptr<std::pmr::memory_resource> scratch)
 {
-	friend bool operator<(ls_state const& a, ls_state const& b)
-	{
-		if (a.nl > b.nl) return false;
-		else if (a.nl < b.nl) return true;
-
-		if (a.i > b.i) return false;
-		else if (a.i < b.i) return true;
-
-		if (a.j > b.j) return false;
-		else if (a.j < b.j) return true;
-
-		return a.r < b.r;
-	}
-
-	void clear()
-	{
-		i = 0;
-		j = 0;
-		r = 0;
-		nl = 0;
-	}
-
-	std::size_t i = 0, j = 0, r = 0;
-	int nl = 0;
-};
+	this->scratch = scratch;
+}
 
-int LocalSearch::findLocalMinimum(Solution& solution)
+void LocalSearchBase::SetPerturbation(Perturbation perturbation)
 {
-	int improvementCount = 0;
-	const int neighbourhood_level_cnt = 4;
-
-	// Do a bit of preprocessing
-	auto n = solution.GetInstance()->GetSize();
-	auto gammaset = solution.GetInstance()->GetGammaSet();
-	auto k = gammaset->getK();
-	std::vector<Node> ni_order(n - 1), j_order(k), r_order(k);
-	for (Node i = 1; i < n; ++i) ni_order[i - 1] = i;
-	for (Node i = 0; i < k; ++i) r_order[i] = j_order[i] = i;
+	this->perturbation = perturbation;
+}
 
-	// Shuffle i and j and r orders
-	std::shuffle(ni_order.begin(), ni_order.end(), rng);
-	std::shuffle(j_order.begin(), j_order.end(), rng);
-	std::shuffle(r_order.begin(), r_order.end(), rng);
+void LocalSearchBase::SetPerturbationBandit(
+	std::shared_ptr<PerturbationBandit> bandit)
+{
+	this->perturbation_bandit = bandit;
+}
 
-	bool improved_once = false;
-	ls_state curr_state, prev_improv, last_improv;
-	std::size_t LB = 0, UB = n;
-	while (curr_state.nl < neighbourhood_level_cnt) {
-		improved_once = false;
-		for (curr_state.i = 0; curr_state.i < n - 1; ++curr_state.i) {
-			auto ni = ni_order[curr_state.i];
-			auto const& ni_neighbours = gammaset->getClosestNeighbours(ni);
-			auto i = solution.GetIndexOf(ni);
-			for (curr_state.j = 0; curr_state.j < k; ++curr_state.j) {
-				auto nj_ = j_order[curr_state.j];
-				auto nj = ni_neighbours[nj_];
-				bool improved = false;
-				auto j = solution.GetIndexOf(nj);
-				std::size_t lb_temp = 0, ub_temp = n;
-				std::size_t* lb_ptr = nullptr;
-				std::size_t* ub_ptr = nullptr;
-				if (curr_state < last_improv && prev_improv < curr_state) {
-					lb_ptr = &LB;
-					ub_ptr = &UB;
-				} else {
-					lb_ptr = &lb_temp;
-					ub_ptr = &ub_temp;
-				}
-				switch (curr_state.nl) {
-				case 0:
-					improved = solution.Shift(i, j, true, lb_ptr, ub_ptr);
-					break;
-				case 1:
-					improved = solution.Opt2(i, j, true, lb_ptr, ub_ptr);
-					break;
-				case 2:
-					improved = solution.Swap(i, j, true, lb_ptr, ub_ptr);
-					break;
-				case 3:
-					for (curr_state.r = 0; curr_state.r < k; ++curr_state.r) {
-						auto nr_ = r_order[curr_state.r];
-						auto nr = ni_neighbours[nr_];
-						auto r = solution.GetIndexOf(nr);
-						improved = solution.Shift2(i, j, r, true, lb_ptr, ub_ptr);
-						if (improved) break;
-					}
-					break;
-				}
-				if (improved) {
-					LB = lb_temp;
-					UB = ub_temp;
+void LocalSearchBase::RewardPerturbation(Cost gain)
+{
+	if (perturbation != Perturbation::Bandit || !perturbation_bandit) return;
+	perturbation_bandit->Reward(perturbation_arm,
+		(double) std::max(gain, (Cost) 0), perturbation_effort);
+}
 
-					if (curr_state < last_improv)
-						prev_improv.clear(); // goes to '0'
-					else
-						prev_improv = last_improv;
+void LocalSearchBase::perturbSolution(Solution& solution,
+	                              std::size_t pertubationSize,
+	                              std::vector<Node>* touched_nodes)
+{
+	auto type = perturbation;
+	if (type == Perturbation::Bandit) {
+		if (!perturbation_bandit)
+			perturbation_bandit = std::make_shared<PerturbationBandit>();
+		perturbation_arm = perturbation_bandit->Select();
+		type = (Perturbation) perturbation_arm;
+	}
+	perturbation_effort = 0;
 
-					last_improv = curr_state;
-					curr_state.nl = 0;
-					curr_state.r = 0;
-					improved_once = true;
-					++improvementCount;
-				}
-			}
-		}
-		if (!improved_once) {
-			++curr_state.nl;
-		}
+	if (type != Perturbation::Moves) {
+		perturbSegment(solution, pertubationSize, type, touched_nodes);
+		return;
 	}
-	return improvementCount;
-}
 
-void LocalSearch::perturbSolution(Solution& solution,
-	                              std::size_t pertubationSize)
-{
 	const int neighbourhood_level_cnt = 4;
 	int neighbourhood_level = neighbourhood_level_cnt - 1;
 
@@ -137,7 +70,8 @@ void LocalSearch::perturbSolution(Solution& solution,
 	auto n = solution.GetInstance()->GetSize();
 	auto gammaset = solution.GetInstance()->GetGammaSet();
 	auto k = gammaset->getK();
-	std::vector<Node> ni_order(n - 1), j_order(k), r_order(k);
+	std::pmr::monotonic_buffer_resource arena(scratch.get());
+	std::pmr::vector<Node> ni_order(n - 1, &arena), j_order(k, &arena), r_order(k, &arena);
 	for (Node i = 1; i < n; ++i) ni_order[i - 1] = i;
 	for (Node i = 0; i < k; ++i) r_order[i] = j_order[i] = i;
 
@@ -157,16 +91,18 @@ void LocalSearch::perturbSolution(Solution& solution,
 				auto nj = ni_neighbours[_j];
 				bool applied = false;
 				std::size_t size = 0;
+				std::size_t lb = 0, ub = n;
+				Node nr = ni;
 				auto j = solution.GetIndexOf(nj);
 				switch (neighbourhood_level) {
 				case 0:
 					size = 1;
-					applied = solution.Shift(i, j, false);
+					applied = solution.Shift(i, j, false, &lb, &ub);
 					break;
 				case 1:
 					size = 2;
 					if (pertubationSize < size) continue;
-					applied = solution.Swap(i, j, false);
+					applied = solution.Swap(i, j, false, &lb, &ub);
 					break;
 				case 2:
 					if (j > i)
@@ -174,7 +110,7 @@ void LocalSearch::perturbSolution(Solution& solution,
 					else
 						size = i - j + 1;
 					if (pertubationSize < size) continue;
-					applied = solution.Opt2(i, j, false);
+					applied = solution.Opt2(i, j, false, &lb, &ub);
 					break;
 				case 3:
 					if (j > i)
@@ -183,14 +119,17 @@ void LocalSearch::perturbSolution(Solution& solution,
 						size = i - j + 1;
 					if (pertubationSize < size) continue;
 					for (auto const& _r : r_order) {
-						auto nr = ni_neighbours[_r];
+						nr = ni_neighbours[_r];
 						auto r = solution.GetIndexOf(nr);
-						applied = solution.Shift2(i, j, r, false);
+						applied = solution.Shift2(i, j, r, false, &lb, &ub);
 						if (applied) break;
 					}
 					break;
 				}
 				if (applied) {
+					if (touched_nodes)
+						forEachTouchedNode(solution, lb, ub, { ni, nj, nr },
+							[&](Node node) { touched_nodes->push_back(node); });
 					neighbourhood_level = (neighbourhood_level + 1) % 
 						                   neighbourhood_level_cnt;
 					perturbedOnce = true;
@@ -207,4 +146,196 @@ ended_perturbation:
 		}
 
 	}
+}
+
+// Rearranges a random segment of clients, in time proportional to
+// the perturbation size (plus a single update of the latency map)
+void LocalSearchBase::perturbSegment(Solution& solution,
+	                                 std::size_t pertubationSize,
+	                                 Perturbation perturbation,
+	                                 std::vector<Node>* touched_nodes)
+{
+	auto n = solution.GetInstance()->GetSize();
+	auto const clients = n - 1;
+	if (n < 3) return;
+
+	auto size = std::clamp(pertubationSize, (std::size_t) 1, clients);
+	auto length = std::max(size, (std::size_t) 2);
+	if (perturbation == Perturbation::MultiShift) {
+		// Room for shifting (shifting every node of the
+		// segment would merely shuffle it)
+		size = std::max(std::min(size, clients / 2), (std::size_t) 1);
+		length = 2 * size;
+	}
+
+	std::uniform_int_distribution<std::size_t> start_unif(1, clients - length + 1);
+	auto start = start_unif(rng);
+
+	std::pmr::monotonic_buffer_resource arena(scratch.get());
+	std::pmr::vector<Node> segment(length, &arena);
+	for (std::size_t i = 0; i < length; ++i)
+		segment[i] = solution.Get(start + i);
+
+	switch (perturbation) {
+	case Perturbation::Moves:
+	case Perturbation::Bandit:
+		break;
+	case Perturbation::DoubleBridge: {
+		/*
+		* BEFORE
+		* ... -- x -- [p ... q] -- [r ... s] -- y -- ...
+		*
+		* AFTER
+		* ... -- x -- [r ... s] -- [p ... q] -- y -- ...
+		*/
+		std::uniform_int_distribution<std::size_t> cut_unif(1, length - 1);
+		std::rotate(segment.begin(), segment.begin() + cut_unif(rng),
+		            segment.end());
+		break;
+	}
+	case Perturbation::Reversal:
+		std::reverse(segment.begin(), segment.end());
+		break;
+	case Perturbation::MultiShift: {
+		// 'size' nodes of the segment are taken out, and put back
+		// in between the others at random (sorting by new slot,
+		// then by their random order, so ties are broken at random)
+		std::pmr::vector<std::size_t> order(length, &arena);
+		for (std::size_t i = 0; i < length; ++i) order[i] = i;
+		std::shuffle(order.begin(), order.end(), rng);
+		std::pmr::vector<bool> is_shifted(length, false, &arena);
+		for (std::size_t i = 0; i < size; ++i)
+			is_shifted[order[i]] = true;
+		std::pmr::vector<Node> kept(&arena);
+		std::pmr::vector<std::tuple<std::size_t, std::size_t, Node>>
+			shifted(&arena);
+		kept.reserve(length - size);
+		shifted.reserve(size);
+		for (std::size_t i = 0; i < length; ++i)
+			if (!is_shifted[i])
+				kept.push_back(segment[i]);
+		std::uniform_int_distribution<std::size_t> slot_unif(0, kept.size());
+		for (std::size_t i = 0; i < size; ++i)
+			shifted.emplace_back(slot_unif(rng), i, segment[order[i]]);
+		std::sort(shifted.begin(), shifted.end());
+		auto it = shifted.begin();
+		segment.clear();
+		for (std::size_t slot = 0; slot <= kept.size(); ++slot) {
+			for (; it != shifted.end() && std::get<0>(*it) == slot; ++it)
+				segment.push_back(std::get<2>(*it));
+			if (slot < kept.size())
+				segment.push_back(kept[slot]);
+		}
+		break;
+	}
+	}
+
+	solution.Rearrange(start, segment.begin(), segment.end());
+
+	if (touched_nodes) {
+		touched_nodes->insert(touched_nodes->end(),
+			segment.begin(), segment.end());
+		if (start > 1)
+			touched_nodes->push_back(solution.Get(start - 1));
+		if (start + length < n)
+			touched_nodes->push_back(solution.Get(start + length));
+	}
+}
+
+int LocalSearchBase::reoptimizeWindows(Solution& solution,
+	                                   std::size_t window_size,
+	                                   std::vector<Node>* touched_nodes)
+{
+	auto n = solution.GetInstance()->GetSize();
+	auto const w = std::min({ window_size, max_window_size, n - 1 });
+	if (w < 2) return 0;
+
+	// In a window of positions [a, a + w), the edge into position
+	// a + t weighs n - a - t + 1 (the nodes whose latency it adds
+	// to), so the cost of an order of the window is the sum of its
+	// edges (from x = Get(a - 1) to y = Get(a + w)) by position
+	std::size_t const full = ((std::size_t) 1 << w) - 1;
+	Cost const infinity = std::numeric_limits<Cost>::max();
+	std::pmr::monotonic_buffer_resource arena(scratch.get());
+	std::pmr::vector<Cost> dp((full + 1) * w, &arena);
+	std::pmr::vector<std::uint8_t> parent((full + 1) * w, &arena);
+	std::pmr::vector<Node> window(w, &arena), order(w, &arena);
+	std::pmr::vector<Dist> dist(w * w, &arena), dist_x(w, &arena), dist_y(w, &arena);
+
+	if (optimal_windows.size() > optimal_windows_max)
+		optimal_windows.clear();
+
+	int improvementCount = 0;
+	for (std::size_t a = 1; a + w <= n; ++a) {
+		Node nx = solution.Get(a - 1), ny = solution.Get(a + w);
+		std::uint64_t hash = 14695981039346656037ull;
+		for (auto word : { (std::uint64_t) a, (std::uint64_t) nx, (std::uint64_t) ny })
+			hash = (hash ^ word) * 1099511628211ull;
+		for (std::size_t t = 0; t < w; ++t) {
+			window[t] = solution.Get(a + t);
+			hash = (hash ^ window[t]) * 1099511628211ull;
+		}
+		if (optimal_windows.count(hash))
+			continue;
+
+		for (std::size_t u = 0; u < w; ++u) {
+			dist_x[u] = solution.GetDist(nx, window[u]);
+			dist_y[u] = solution.GetDist(window[u], ny);
+			for (std::size_t v = 0; v < w; ++v)
+				dist[u * w + v] = solution.GetDist(window[u], window[v]);
+		}
+		Cost const weight = (Cost) (n - a + 1);
+
+		Cost current = weight * dist_x[0] + (weight - (Cost) w) * dist_y[w - 1];
+		for (std::size_t t = 1; t < w; ++t)
+			current += (weight - (Cost) t) * dist[(t - 1) * w + t];
+
+		// dp[S][v]: cheapest order of the nodes in S, ending at v
+		std::fill(dp.begin(), dp.end(), infinity);
+		for (std::size_t v = 0; v < w; ++v)
+			dp[((std::size_t) 1 << v) * w + v] = weight * dist_x[v];
+		for (std::size_t set = 1; set < full; ++set) {
+			Cost const next_weight = weight - (Cost) std::bitset<max_window_size>(set).count();
+			for (std::size_t u = 0; u < w; ++u) {
+				auto cost = dp[set * w + u];
+				if (cost == infinity) continue;
+				for (std::size_t v = 0; v < w; ++v) {
+					if (set & ((std::size_t) 1 << v)) continue;
+					auto next = (set | ((std::size_t) 1 << v)) * w + v;
+					auto next_cost = cost + next_weight * dist[u * w + v];
+					if (next_cost < dp[next]) {
+						dp[next] = next_cost;
+						parent[next] = (std::uint8_t) u;
+					}
+				}
+			}
+		}
+		Cost best = infinity;
+		std::size_t last = 0;
+		for (std::size_t v = 0; v < w; ++v) {
+			auto cost = dp[full * w + v] + (weight - (Cost) w) * dist_y[v];
+			if (cost < best) {
+				best = cost;
+				last = v;
+			}
+		}
+
+		if (best >= current) {
+			optimal_windows.insert(hash);
+			continue;
+		}
+
+		// Walks the best order back from its last node
+		for (std::size_t set = full, t = w; t-- > 0;) {
+			order[t] = window[last];
+			auto prev = parent[set * w + last];
+			set &= ~((std::size_t) 1 << last);
+			last = prev;
+		}
+		solution.Rearrange(a, order.begin(), order.end());
+		++improvementCount;
+		if (touched_nodes)
+			touched_nodes->insert(touched_nodes->end(), order.begin(), order.end());
+	}
+	return improvementCount;
 }
\ No newline at end of file
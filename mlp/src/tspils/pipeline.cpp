@@ -0,0 +1,140 @@
+#include "pipeline.h"
+
+namespace nbh
+{
+	/*
+	* Each step reverses the segment right after the last one,
+	* so the chain only ever reverses consecutive segments:
+	*
+	* BEFORE
+	* ... -- x -- [s1 ... e1] -- [s2 ... e2] -- ... -- [sm ... em] -- y -- ...
+	*
+	* AFTER
+	* ... -- x -- [e1 ... s1] -- [e2 ... s2] -- ... -- [em ... sm] -- y -- ...
+	*
+	* The step of [s, e] after 'from' (x, or the previous s) costs
+	* (n - s + 1) * (D(from, e) - D(s - 1, s)) plus the reversal of its
+	* inner edges, and closing the chain after it costs (n - e) *
+	* (D(s, e + 1) - D(e, e + 1)), all of it in O(1) from the latency
+	* map. The chain goes on while the steps so far improve the cost
+	* (before closing it), each one towards the gamma set neighbour of
+	* the open end that improves it the most.
+	*
+	* Going backwards (j < i), the same holds mirrored: y is the node
+	* at i, each step reverses the segment right before the last one,
+	* [s, e] before 'to' (y, or the previous e) costs (n - e) *
+	* (D(s, to) - D(e, e + 1)) plus its inner edges, and closing the
+	* chain before it costs (n - s + 1) * (D(s - 1, e) - D(s - 1, s)).
+	*/
+	std::optional<Cost> EjectionChain::build(Solution const& s,
+		ds::GammaSet const& gammaset, std::size_t i, std::size_t j,
+		ends_t& ends, std::size_t& depth)
+	{
+		auto n = s.GetInstance()->GetSize();
+		if (i < 1 || j < 1 || i >= n || j >= n) return std::nullopt;
+		bool const forward = j > i;
+		if (forward ? j < i + 2 : i < j + 2) return std::nullopt;
+
+		auto L = [&](std::size_t p) { return s.GetLatencyAt(p); };
+		// Reversal of the inner edges of [st, e]: the edge into
+		// position t + 1 weighs 2t + 1 - st - e more afterwards
+		auto inner = [&](std::size_t st, std::size_t e) {
+			Cost sum = L(e) - L(st);
+			Cost weighted_sum = (Cost) (e - 1) * L(e) - (Cost) st * L(st)
+				- s.GetLatencySum(st + 1, e - 1);
+			return 2 * weighted_sum + (1 - (Cost) st - (Cost) e) * sum;
+		};
+		auto step = [&](Node from, std::size_t st, std::size_t e) {
+			return (Cost) (n - st + 1) *
+				(s.GetDist(from, s.Get(e)) - s.GetDist(s.Get(st - 1), s.Get(st)))
+				+ inner(st, e);
+		};
+		auto close = [&](std::size_t st, std::size_t e) {
+			Node ny = s.Get(e + 1);
+			return (Cost) (n - e) *
+				(s.GetDist(s.Get(st), ny) - s.GetDist(s.Get(e), ny));
+		};
+		auto back_step = [&](Node to, std::size_t st, std::size_t e) {
+			return (Cost) (n - e) *
+				(s.GetDist(s.Get(st), to) - s.GetDist(s.Get(e), s.Get(e + 1)))
+				+ inner(st, e);
+		};
+		auto back_close = [&](std::size_t st, std::size_t e) {
+			Node nx = s.Get(st - 1);
+			return (Cost) (n - st + 1) *
+				(s.GetDist(nx, s.Get(e)) - s.GetDist(nx, s.Get(st)));
+		};
+
+		Cost open = 0, best = 0;
+		Node end = s.Get(i); // Open end of the chain
+		std::size_t st = forward ? i + 1 : j, e = forward ? j : i - 1;
+		depth = 0;
+		for (std::size_t d = 0; d < max_depth; ++d) {
+			open += forward ? step(end, st, e) : back_step(end, st, e);
+			ends[d] = forward ? e : st;
+			auto closed = open + (forward ? close(st, e) : back_close(st, e));
+			if (closed < best) {
+				best = closed;
+				depth = d + 1;
+			}
+			if (open >= 0)
+				break; // Gain criterion
+
+			if (forward) {
+				end = s.Get(st);
+				st = e + 1;
+			} else {
+				end = s.Get(e);
+				e = st - 1;
+			}
+			std::optional<Cost> next_step;
+			std::size_t next = 0;
+			for (auto const& nt : gammaset.getClosestNeighbours(end)) {
+				auto t = s.GetIndexOf(nt);
+				if (forward ? t < st + 1 || t >= n : t < 1 || t + 1 > e)
+					continue;
+				auto cost = forward ? step(end, st, t) : back_step(end, t, e);
+				if (!next_step || cost < *next_step) {
+					next_step = cost;
+					next = t;
+				}
+			}
+			if (!next_step)
+				break;
+			(forward ? e : st) = next;
+		}
+		return best;
+	}
+
+	bool EjectionChain::Apply(Solution& s, ds::GammaSet const& gammaset,
+		std::size_t i, std::size_t j,
+		std::size_t, std::size_t* lb, std::size_t* ub)
+	{
+		ends_t ends;
+		std::size_t depth = 0;
+		auto delta = build(s, gammaset, i, j, ends, depth);
+		if (!delta || *delta >= 0) return false;
+
+		if (j > i) {
+			for (std::size_t d = 0, st = i + 1; d < depth; st = ends[d++] + 1)
+				s.Reverse(st, ends[d]);
+			if (lb) *lb = i;
+			if (ub) *ub = ends[depth - 1] + 1;
+		} else {
+			for (std::size_t d = 0, e = i - 1; d < depth; e = ends[d++] - 1)
+				s.Reverse(ends[d], e);
+			if (lb) *lb = ends[depth - 1] - 1;
+			if (ub) *ub = i;
+		}
+		return true;
+	}
+
+	std::optional<Cost> EjectionChain::Evaluate(Solution const& s,
+		ds::GammaSet const& gammaset, std::size_t i, std::size_t j,
+		std::size_t)
+	{
+		ends_t ends;
+		std::size_t depth = 0;
+		return build(s, gammaset, i, j, ends, depth);
+	}
+}
\ No newline at end of file
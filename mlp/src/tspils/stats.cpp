@@ -0,0 +1,29 @@
+#include "stats.h"
+
+NeighbourhoodStats& NeighbourhoodStats::operator+= (NeighbourhoodStats const& stats)
+{
+	evaluations += stats.evaluations;
+	filter_rejects += stats.filter_rejects;
+	applied += stats.applied;
+	gain += stats.gain;
+	wall_seconds += stats.wall_seconds;
+	cpu_seconds += stats.cpu_seconds;
+	return *this;
+}
+
+void AccumulateStats(SearchStats& total, SearchStats const& stats)
+{
+	if (total.empty()) {
+		total.resize(stats.size());
+		for (std::size_t nl = 0; nl < stats.size(); ++nl)
+			total[nl].name = stats[nl].name;
+	}
+	for (std::size_t nl = 0; nl < stats.size() && nl < total.size(); ++nl)
+		total[nl] += stats[nl];
+}
+
+void ResetStats(SearchStats& stats)
+{
+	for (auto& nbh_stats : stats)
+		nbh_stats = NeighbourhoodStats { nbh_stats.name };
+}
\ No newline at end of file
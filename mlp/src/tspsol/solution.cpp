@@ -1,5 +1,5 @@
 #include "solution.h"
-#include "iparser.h"
+#include "registry.h"
 
 #include <cassert>
 #include <algorithm>
@@ -12,19 +12,60 @@ unsigned long long Solution::_count = 0;
 
 Solution::Solution() : _id(_count++) {}
 
+Solution::Solution(std::shared_ptr<std::pmr::memory_resource> resource) :
+	SolutionResource { resource },
+	std::pmr::list<Node>(memory()),
+	latency_map(memory()),
+	latency_sum_map(memory()),
+	node_map(memory()),
+	index_map(memory()),
+	_id(_count++)
+{}
+
 Solution::Solution (Solution const& solution) :
-	std::list<Node>(solution),
-	latency_map(solution.latency_map),
+	Solution(solution, solution.resource)
+{}
+
+Solution::Solution (Solution const& solution,
+	std::shared_ptr<std::pmr::memory_resource> resource) :
+	SolutionResource { resource },
+	std::pmr::list<Node>(solution, memory()),
+	latency_map(solution.latency_map, memory()),
+	latency_sum_map(solution.latency_sum_map, memory()),
+	node_map(solution.node_map, memory()),
+	index_map(solution.index_map, memory()),
 	instance_ptr(solution.instance_ptr),
+	dmatrix(solution.dmatrix),
 	_id(_count++)
 {}
 
+Solution& Solution::operator= (Solution const& solution)
+{
+	if (this == &solution) return *this;
+	std::pmr::list<Node>::operator=(solution);
+	latency_map = solution.latency_map;
+	latency_sum_map = solution.latency_sum_map;
+	node_map = solution.node_map;
+	index_map = solution.index_map;
+	instance_ptr = solution.instance_ptr;
+	dmatrix = solution.dmatrix;
+	_id = solution._id;
+	return *this;
+}
+
 Solution::Solution(std::shared_ptr<Instance> instance_ptr,
 	std::size_t window_size, std::default_random_engine& rng) :
-	instance_ptr(instance_ptr),
-	latency_map(instance_ptr->GetSize() + 1),
-	_id(_count++)
+	Solution(instance_ptr, window_size, rng, nullptr)
+{}
+
+Solution::Solution(std::shared_ptr<Instance> instance_ptr,
+	std::size_t window_size, std::default_random_engine& rng,
+	std::shared_ptr<std::pmr::memory_resource> resource) :
+	Solution(resource)
 {
+	this->instance_ptr = instance_ptr;
+	dmatrix = &instance_ptr->GetDistanceMatrix(); // loads the instance
+	latency_map.resize(instance_ptr->GetSize() + 1);
 	std::size_t n = instance_ptr->GetSize();
 	std::vector<bool> added_clients(n, false);
 	Node node = 0;
@@ -55,7 +96,7 @@ Solution::Solution(std::shared_ptr<Instance> instance_ptr,
 			Dist min_dist = max_dist;
 			for (Node j = 1; j < n; ++j) {
 				if (!added_clients[j]) {
-					Dist dist = (*instance_ptr)[node][j];
+					Dist dist = GetDist(node, j);
 					if (dist < min_dist) {
 						closest_node = j;
 						min_dist = dist;
@@ -74,31 +115,43 @@ Solution::Solution(std::shared_ptr<Instance> instance_ptr,
 
 std::size_t Solution::GetIndexOf (Node node) const
 {
-	auto it = std::find(begin(), end(), node);
-	if (it == end()) return -1;
-	return std::distance(begin(), it);
+	if (node >= index_map.size()) return -1;
+	return index_map[node];
 }
 
 // l(S,0) = 0
 // l(S,1) = d(s_0,s_1)
 // l(S,i) = d(s_{i-1},s_i) + l(S,i-1), i <= n
+//
+// Node positions are updated along, since every
+// move changes the sequence only from 'pos' onwards
 void Solution::recalculateLatencyMap(std::size_t pos)
 {
 	Cost latency = 0;
 	auto it = begin(),
 		 prev = begin();
 
+	node_map.resize(size());
+	index_map.resize(size() - 1);
+	latency_sum_map.resize(size());
+
 	std::advance(it, pos);
 
 	if (pos > 1) {
 		std::advance(prev, pos - 1);
 		latency = latency_map[pos - 1];
 	}
+	Cost latency_sum = pos > 0 ? latency_sum_map[pos - 1] : 0;
 
 	while (it != end()) {
 		if (it != prev)
 			latency += GetDist(*prev, *it);
 		latency_map[pos] = latency;
+		latency_sum += latency;
+		latency_sum_map[pos] = latency_sum;
+		node_map[pos] = *it;
+		if (pos + 1 < node_map.size())
+			index_map[*it] = pos; // final depot is not indexed
 		prev = it;
 		++it;
 		++pos;
@@ -135,10 +188,11 @@ Solution* crossover(Solution const& sa, Solution const& sb,
 			sol_is_a = !sol_is_a; // alternates solution
 		}
 	}
-	auto sol = new Solution();
+	auto sol = new Solution(sa.resource);
 	sol->instance_ptr = sa.instance_ptr;
+	sol->dmatrix = sa.dmatrix;
 	sol->insert(sol->begin(), sol_vec.begin(), sol_vec.end());
-	sol->latency_map = std::vector<Cost>(n + 1);
+	sol->latency_map.assign(n + 1, 0);
 	sol->recalculateLatencyMap();
 	return sol;
 }
@@ -154,14 +208,15 @@ std::ifstream& operator>> (std::ifstream& ifs, Solution& s)
 	}
 	if (!std::getline(ifs, source_file))
 		return ifs; // I/O error
-	auto iparser = InstanceParser::Open(source_file);
-	auto instance_ptr_opt = iparser->Parse();
-	if (!instance_ptr_opt) {
+	auto registry = InstanceRegistry::GetInstance();
+	auto instance_ptr_opt = registry->Get(source_file);
+	if (!instance_ptr_opt || !(*instance_ptr_opt)->Load()) {
 		std::cerr << "Could not parse instance source file.\n";
 		ifs.setstate(std::ios::failbit);
 		return ifs; // Logic error
 	}
 	s.instance_ptr = *instance_ptr_opt;
+	s.dmatrix = &s.instance_ptr->GetDistanceMatrix();
 	s.push_back(0); // initial depot
 	auto n = (*instance_ptr_opt)->GetSize();
 	std::vector<bool> added_nodes(n - 1, false);
@@ -182,18 +237,20 @@ std::ifstream& operator>> (std::ifstream& ifs, Solution& s)
 		added_nodes[(std::size_t) nodei - 1] = true;
 	}
 	s.push_back(0); // final depot
-	s.latency_map = std::vector<Cost>(n + 1);
+	s.latency_map.assign(n + 1, 0);
 	s.recalculateLatencyMap();
 	return ifs; // Ok
 }
 
 Cost Solution::GetCost () const
 {
-	Cost cost = 0;
-	auto n = instance_ptr->GetSize();
-	for (std::size_t i = 1; i <= n; ++i)
-		cost += latency_map[i];
-	return cost;
+	return latency_sum_map[instance_ptr->GetSize()];
+}
+
+Cost Solution::GetLatencySum (std::size_t p, std::size_t q) const
+{
+	if (p > q) return 0;
+	return latency_sum_map[q] - (p > 0 ? latency_sum_map[p - 1] : 0);
 }
 
 std::optional<double> Solution::GetCostGap () const
@@ -207,9 +264,7 @@ std::optional<double> Solution::GetCostGap () const
 
 Node Solution::Get (std::size_t index) const
 {
-	auto it = begin();
-	std::advance(it, index);
-	return *it;
+	return node_map[index];
 }
 
 Cost Solution::GetLatencyAt(std::size_t index) const
@@ -219,7 +274,7 @@ Cost Solution::GetLatencyAt(std::size_t index) const
 
 Dist Solution::GetDist(Node i, Node j) const
 {
-	return (*instance_ptr)[i][j];
+	return (*dmatrix)[i][j];
 }
 
 std::shared_ptr<Instance> Solution::GetInstance ()  const
@@ -294,7 +349,7 @@ void Solution::PrintLatencyMap() const
 	std::cout << " ]\n";
 }
 
-bool Solution::Shift (std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t* ub)
+bool Solution::filterShift (std::size_t p, std::size_t q) const
 {
 	auto n = instance_ptr->GetSize();
 
@@ -307,75 +362,86 @@ bool Solution::Shift (std::size_t p, std::size_t q, bool improve, std::size_t* l
 	if (q <= 0 || q >= n) return false;
 	if (p == q) return false;
 
-	auto const max = std::max(p, q);
-	auto const min = std::min(p, q);
+	return true;
+}
 
-	/* Check lower and upper bounds */
-	if (lb && max < *lb) return false;
-	if (ub && min > *ub) return false;
-	
+Cost Solution::shiftDelta (std::size_t p, std::size_t q) const
+{
+	auto n = instance_ptr->GetSize();
 	Node np = Get(p), nq = Get(q);
 
-	if (improve) {
+	if (p < q) {
 
-		Cost delta = 0;
+		/*
+		* BEFORE
+		* ... -- x -- p -- y -- ... -- q -- w -- ...
+		*
+		* AFTER
+		* ... -- x -- y -- ... -- q -- p -- w -- ...
+		*/
 
-		if (p < q) {
+		Node nx = Get(p - 1), ny = Get(p + 1), nw = Get(q + 1);
 
-			/*
-			* BEFORE
-			* ... -- x -- p -- y -- ... -- q -- w -- ...
-			*
-			* AFTER
-			* ... -- x -- y -- ... -- q -- p -- w -- ...
-			*/
+		Cost dxy = GetDist(nx, ny), dqp = GetDist(nq, np),
+			dpw = GetDist(np, nw), dxp = GetDist(nx, np),
+			dpy = GetDist(np, ny), dqw = GetDist(nq, nw);
 
-			Node nx = Get(p - 1), ny = Get(p + 1), nw = Get(q + 1);
+		return (n - p + 1) * (dxy - dxp)
+			+ (n - q) * (dpw - dqw)
+			+ (n - q + 1) * dqp
+			+ latency_map[q]
+			- latency_map[p + 1]
+			- (n - p) * dpy;
 
-			Cost dxy = GetDist(nx, ny), dqp = GetDist(nq, np),
-				dpw = GetDist(np, nw), dxp = GetDist(nx, np),
-				dpy = GetDist(np, ny), dqw = GetDist(nq, nw);
+	} else {
+
+		/*
+		* BEFORE
+		* ... -- x -- q -- ... -- y -- p -- w -- ...
+		*
+		* AFTER
+		* ... -- x -- p -- q -- ... -- y -- w -- ...
+		*/
 
-			delta = (n - p + 1) * (dxy - dxp)
-				+ (n - q) * (dpw - dqw)
-				+ (n - q + 1) * dqp
-				+ latency_map[q]
-				- latency_map[p + 1]
-				- (n - p) * dpy;
+		Node nx = Get(q - 1), ny = Get(p - 1), nw = Get(p + 1);
 
-		} else {
+		Cost dxp = GetDist(nx, np), dpq = GetDist(np, nq),
+			dyw = GetDist(ny, nw), dxq = GetDist(nx, nq),
+			dyp = GetDist(ny, np), dpw = GetDist(np, nw);
 
-			/*
-			* BEFORE
-			* ... -- x -- q -- ... -- y -- p -- w -- ...
-			*
-			* AFTER
-			* ... -- x -- p -- q -- ... -- y -- w -- ...
-			*/
+		return (n - q + 1) * (dxp - dxq)
+			+ (n - p) * (dyw - dpw)
+			+ (n - q) * dpq
+			+ latency_map[q]
+			- latency_map[p - 1]
+			- (n - p + 1) * dyp;
+
+	}
+}
 
-			Node nx = Get(q - 1), ny = Get(p - 1), nw = Get(p + 1);
+std::optional<Cost> Solution::GetShiftDelta (std::size_t p, std::size_t q) const
+{
+	if (!filterShift(p, q)) return std::nullopt;
+	return shiftDelta(p, q);
+}
 
-			Cost dxp = GetDist(nx, np), dpq = GetDist(np, nq),
-				dyw = GetDist(ny, nw), dxq = GetDist(nx, nq),
-				dyp = GetDist(ny, np), dpw = GetDist(np, nw);
+bool Solution::Shift (std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t* ub)
+{
+	if (!filterShift(p, q)) return false;
 
-			delta = (n - q + 1) * (dxp - dxq)
-				+ (n - p) * (dyw - dpw)
-				+ (n - q) * dpq
-				+ latency_map[q]
-				- latency_map[p - 1]
-				- (n - p + 1) * dyp;
+	auto const max = std::max(p, q);
+	auto const min = std::min(p, q);
 
-		}
-		
-		/* Does not accept solution of same cost */
-		if (delta >= 0) return false;
+	/* Check lower and upper bounds */
+	if (lb && max < *lb) return false;
+	if (ub && min > *ub) return false;
 
-	}
+	/* Does not accept solution of same cost */
+	if (improve && shiftDelta(p, q) >= 0) return false;
 
-	/* Apply move */
-	remove(np);
-	insert(std::next(begin(), q), np);
+	/* Apply move (splicing, so that no node is reallocated) */
+	splice(std::next(begin(), p < q ? q + 1 : q), *this,
+		std::next(begin(), p));
 
 	/* Update latency map */
 	recalculateLatencyMap(min);
@@ -387,7 +453,7 @@ bool Solution::Shift (std::size_t p, std::size_t q, bool improve, std::size_t* l
 	return true;
 }
 
-bool Solution::Swap(std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t *ub)
+bool Solution::filterSwap (std::size_t& p, std::size_t& q) const
 {
 	auto n = instance_ptr->GetSize();
 
@@ -401,41 +467,55 @@ bool Solution::Swap(std::size_t p, std::size_t q, bool improve, std::size_t* lb,
 	if (p == q) return false;
 	if (p > q) std::swap(p, q);
 
-	/* Check lower and upper bounds */
-	if (lb && q < *lb) return false;
-	if (ub && p > *ub) return false;
-	
 	/* The same as shift(p,q) */
 	if (q == p + 1) return false;
 
-	if (improve) {
+	return true;
+}
 
-		/*
-		* BEFORE
-		* ... -- x -- p -- y -- ... -- z -- q -- w -- ...
-		*
-		* AFTER
-		* ... -- x -- q -- y -- ... -- z -- p -- w -- ...
-		*/
+Cost Solution::swapDelta (std::size_t p, std::size_t q) const
+{
+	auto n = instance_ptr->GetSize();
 
-		Node np = Get(p), nq = Get(q),
-			nx = Get(p - 1), ny = Get(p + 1),
-			nz = Get(q - 1), nw = Get(q + 1);
+	/*
+	* BEFORE
+	* ... -- x -- p -- y -- ... -- z -- q -- w -- ...
+	*
+	* AFTER
+	* ... -- x -- q -- y -- ... -- z -- p -- w -- ...
+	*/
+
+	Node np = Get(p), nq = Get(q),
+		nx = Get(p - 1), ny = Get(p + 1),
+		nz = Get(q - 1), nw = Get(q + 1);
+
+	Cost dxq = GetDist(nx, nq), dqy = GetDist(nq, ny),
+		dzp = GetDist(nz, np), dpw = GetDist(np, nw),
+		dxp = GetDist(nx, np), dpy = GetDist(np, ny),
+		dzq = GetDist(nz, nq), dqw = GetDist(nq, nw);
+
+	return (n - p + 1) * (dxq - dxp)
+		+ (n - p) * (dqy - dpy)
+		+ (n - q + 1) * (dzp - dzq)
+		+ (n - q) * (dpw - dqw);
+}
 
-		Cost dxq = GetDist(nx, nq), dqy = GetDist(nq, ny),
-			dzp = GetDist(nz, np), dpw = GetDist(np, nw),
-			dxp = GetDist(nx, np), dpy = GetDist(np, ny),
-			dzq = GetDist(nz, nq), dqw = GetDist(nq, nw);
+std::optional<Cost> Solution::GetSwapDelta (std::size_t p, std::size_t q) const
+{
+	if (!filterSwap(p, q)) return std::nullopt;
+	return swapDelta(p, q);
+}
 
-		Cost delta = (n - p + 1) * (dxq - dxp)
-			+ (n - p) * (dqy - dpy)
-			+ (n - q + 1) * (dzp - dzq)
-			+ (n - q) * (dpw - dqw);
+bool Solution::Swap(std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t *ub)
+{
+	if (!filterSwap(p, q)) return false;
 
-		/* Does not accept solution of same cost */
-		if (delta >= 0) return false;
+	/* Check lower and upper bounds */
+	if (lb && q < *lb) return false;
+	if (ub && p > *ub) return false;
 
-	}
+	/* Does not accept solution of same cost */
+	if (improve && swapDelta(p, q) >= 0) return false;
 
 	/* Apply move */
 	std::swap(*std::next(begin(), p),
@@ -451,7 +531,7 @@ bool Solution::Swap(std::size_t p, std::size_t q, bool improve, std::size_t* lb,
 	return true;
 }
 
-bool Solution::Opt2(std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t* ub)
+bool Solution::filterOpt2 (std::size_t& p, std::size_t& q) const
 {
 	auto n = instance_ptr->GetSize();
 
@@ -465,48 +545,68 @@ bool Solution::Opt2(std::size_t p, std::size_t q, bool improve, std::size_t* lb,
 	if (p == q) return false;
 	if (p > q) std::swap(p, q);
 
-	/* Check lower and upper bounds */
-	if (lb && q < *lb) return false;
-	if (ub && p > *ub) return false;
-	
 	/* The same as shift(p,q) */
 	if (q == p + 1) return false;
 
 	/* The same as swap(p,q) */
 	if (q == p + 2) return false;
 
-	if (improve) {
+	return true;
+}
 
-		/*
-		* BEFORE
-		* ... -- x -- p -- p+1 -- ... -- q-1 -- q -- y -- ...
-		*
-		* AFTER
-		* ... -- x -- q -- q-1 -- ... -- p+1 -- p -- y -- ...
-		*/
+Cost Solution::opt2Delta (std::size_t p, std::size_t q) const
+{
+	auto n = instance_ptr->GetSize();
 
-		Node np = Get(p), nq = Get(q),
-			nx = Get(p - 1), ny = Get(q + 1);
+	/*
+	* BEFORE
+	* ... -- x -- p -- p+1 -- ... -- q-1 -- q -- y -- ...
+	*
+	* AFTER
+	* ... -- x -- q -- q-1 -- ... -- p+1 -- p -- y -- ...
+	*/
 
-		Cost dxp = GetDist(nx, np), dqy = GetDist(nq, ny),
-			dxq = GetDist(nx, nq), dpy = GetDist(np, ny);
+	Node np = Get(p), nq = Get(q),
+		nx = Get(p - 1), ny = Get(q + 1);
 
-		Cost delta = (n - p + 1) * (dxq - dxp)
-			+ (n - q) * (dpy - dqy);
+	Cost dxp = GetDist(nx, np), dqy = GetDist(nq, ny),
+		dxq = GetDist(nx, nq), dpy = GetDist(np, ny);
 
-		auto it = std::next(begin(), p + 1);
-		auto prev = std::prev(it);
-		auto end = std::next(begin(), q + 1);
-		long long up = p, uq = q;
-		long long pos = up + 1;
+	Cost delta = (n - p + 1) * (dxq - dxp)
+		+ (n - q) * (dpy - dqy);
 
-		for (; it != end; ++it, ++prev, ++pos)
-			delta += GetDist(*prev, *it) * (2 * pos - up - uq - 1);
+	long long up = p, uq = q;
 
-		/* Does not accept solution of same cost */
-		if (delta >= 0) return false;
+	for (std::size_t pos = p + 1; pos <= q; ++pos)
+		delta += GetDist(Get(pos - 1), Get(pos)) * (2 * (long long) pos - up - uq - 1);
 
-	}
+	return delta;
+}
+
+void Solution::Reverse (std::size_t p, std::size_t q)
+{
+	if (p >= q) return;
+	std::reverse(std::next(begin(), p),
+	             std::next(begin(), q+1));
+	recalculateLatencyMap(p);
+}
+
+std::optional<Cost> Solution::GetOpt2Delta (std::size_t p, std::size_t q) const
+{
+	if (!filterOpt2(p, q)) return std::nullopt;
+	return opt2Delta(p, q);
+}
+
+bool Solution::Opt2(std::size_t p, std::size_t q, bool improve, std::size_t* lb, std::size_t* ub)
+{
+	if (!filterOpt2(p, q)) return false;
+
+	/* Check lower and upper bounds */
+	if (lb && q < *lb) return false;
+	if (ub && p > *ub) return false;
+
+	/* Does not accept solution of same cost */
+	if (improve && opt2Delta(p, q) >= 0) return false;
 
 	/* Apply move */
 	std::reverse(std::next(begin(), p),
@@ -522,7 +622,7 @@ bool Solution::Opt2(std::size_t p, std::size_t q, bool improve, std::size_t* lb,
 	return true;
 }
 
-bool Solution::Shift2(std::size_t p, std::size_t q, std::size_t r, bool improve, std::size_t* lb, std::size_t* ub)
+bool Solution::filterShift2 (std::size_t& p, std::size_t& q, std::size_t r) const
 {
 	auto n = instance_ptr->GetSize();
 
@@ -538,105 +638,111 @@ bool Solution::Shift2(std::size_t p, std::size_t q, std::size_t r, bool improve,
 	if (p == q) return false;
 	if (p > q) std::swap(p, q);
 
-	auto const min = std::min(p, r);
-	auto const max = std::max(q, r);
+	/* Invalid r */
+	if (r >= p && r <= q) return false;
 
-	/* Check lower and upper bounds */
-	if (lb && max < *lb) return false;
-	if (ub && min > *ub) return false;
+	/* Same as shift(r,p) */
+	if (r == q + 1) return false;
 
-	if (r > q) {
+	/* Same as shift(r,q) */
+	if (r == p - 1) return false;
 
-		// rightshift2
+	return true;
+}
 
-		/* Same as shift(r,p) */
-		if (r == q + 1) return false;
+Cost Solution::shift2Delta (std::size_t p, std::size_t q, std::size_t r) const
+{
+	auto n = instance_ptr->GetSize();
 
-		if (improve) {
+	if (r > q) {
 
-			/*
-			* BEFORE
-			* ... -- x -- p -- ... -- q -- y -- ... -- r -- z -- ...
-			*
-			* AFTER
-			* ... -- x -- y -- ... -- r -- p -- ... -- q -- z -- ...
-			*/
+		// rightshift2
 
-			Node np = Get(p), nq = Get(q), nr = Get(r),
-				nx = Get(p - 1), ny = Get(q + 1), nz = Get(r + 1);
+		/*
+		* BEFORE
+		* ... -- x -- p -- ... -- q -- y -- ... -- r -- z -- ...
+		*
+		* AFTER
+		* ... -- x -- y -- ... -- r -- p -- ... -- q -- z -- ...
+		*/
 
-			Cost dxy = GetDist(nx, ny), drp = GetDist(nr, np),
-				dqz = GetDist(nq, nz), dxp = GetDist(nx, np),
-				dqy = GetDist(nq, ny), drz = GetDist(nr, nz);
+		Node np = Get(p), nq = Get(q), nr = Get(r),
+			nx = Get(p - 1), ny = Get(q + 1), nz = Get(r + 1);
 
-			Cost delta = (n - p + 1) * (dxy - dxp)
-				+ (n - r) * (dqz - drz)
-				+ (n + q - p - r + 1) * drp
-				+ (n - q) * dqy
-				+ (q - p + 1) * (latency_map[r] - latency_map[q + 1])
-				+ (r - q) * (latency_map[p] - latency_map[q]);
+		Cost dxy = GetDist(nx, ny), drp = GetDist(nr, np),
+			dqz = GetDist(nq, nz), dxp = GetDist(nx, np),
+			dqy = GetDist(nq, ny), drz = GetDist(nr, nz);
 
-			/* Does not accept solution of same cost */
-			if (delta >= 0) return false;
-		}
+		return (n - p + 1) * (dxy - dxp)
+			+ (n - r) * (dqz - drz)
+			+ (n + q - p - r + 1) * drp
+			- (n - q) * dqy
+			+ (q - p + 1) * (latency_map[r] - latency_map[q + 1])
+			+ (r - q) * (latency_map[p] - latency_map[q]);
 
-		/* Apply move */
-		splice(std::next(begin(), r + 1), *this,
-			std::next(begin(), p),
-			std::next(begin(), q + 1));
+	} else {
 
-		/* Update latency map */
-		recalculateLatencyMap(p);
+		// leftshift2
 
-	} else if (r < p) {
+		/*
+		* BEFORE
+		* ... -- x -- r -- ... -- y -- p -- ... -- q -- z -- ...
+		*
+		* AFTER
+		* ... -- x -- p -- ... -- q -- r -- ... -- y -- z -- ...
+		*/
 
-		// leftshift2
+		Node np = Get(p), nq = Get(q), nr = Get(r),
+			nx = Get(r - 1), ny = Get(p - 1), nz = Get(q + 1);
 
-		/* Same as shift(r,q) */
-		if (r == p - 1) return false;
+		Cost dxp = GetDist(nx, np), dxr = GetDist(nx, nr),
+			dyz = GetDist(ny, nz), dqz = GetDist(nq, nz),
+			dqr = GetDist(nq, nr), dyp = GetDist(ny, np);
 
-		if (improve) {
+		return (n - r + 1) * (dxp - dxr)
+			+ (n - q) * (dyz - dqz)
+			+ (n + p - q - r) * dqr
+			+ (p - r) * (latency_map[q] - latency_map[p])
+			- (q - p + 1) * (latency_map[p - 1] - latency_map[r])
+			- (n - p + 1) * dyp;
 
-			/*
-			* BEFORE
-			* ... -- x -- r -- ... -- y -- p -- ... -- q -- z -- ...
-			*
-			* AFTER
-			* ... -- x -- p -- ... -- q -- r -- ... -- y -- z -- ...
-			*/
+	}
+}
 
-			Node np = Get(p), nq = Get(q), nr = Get(r),
-				nx = Get(r - 1), ny = Get(p - 1), nz = Get(q + 1);
+std::optional<Cost> Solution::GetShift2Delta (std::size_t p, std::size_t q, std::size_t r) const
+{
+	if (!filterShift2(p, q, r)) return std::nullopt;
+	return shift2Delta(p, q, r);
+}
 
-			Cost dxp = GetDist(nx, np), dxr = GetDist(nx, nr),
-				dyz = GetDist(ny, nz), dqz = GetDist(nq, nz),
-				dqr = GetDist(nq, nr), dyp = GetDist(ny, np);
+bool Solution::Shift2(std::size_t p, std::size_t q, std::size_t r, bool improve, std::size_t* lb, std::size_t* ub)
+{
+	if (!filterShift2(p, q, r)) return false;
 
-			Cost delta = (n - r + 1) * (dxp - dxr)
-				+ (n - q) * (dyz - dqz)
-				+ (n + p - q - r) * dqr
-				+ (p - r) * (latency_map[q] - latency_map[p])
-				- (q - p + 1) * (latency_map[p - 1] - latency_map[r])
-				- (n - p + 1) * dyp;
+	auto const min = std::min(p, r);
+	auto const max = std::max(q, r);
 
-			/* Does not accept solution of same cost */
-			if (delta >= 0) return false;
-		}
+	/* Check lower and upper bounds */
+	if (lb && max < *lb) return false;
+	if (ub && min > *ub) return false;
 
-		/* Apply move */
-		splice(std::next(begin(), r), *this,
+	/* Does not accept solution of same cost */
+	if (improve && shift2Delta(p, q, r) >= 0) return false;
+
+	/* Apply move */
+	if (r > q) {
+		splice(std::next(begin(), r + 1), *this,
 			std::next(begin(), p),
 			std::next(begin(), q + 1));
-
-		/* Update latency map */
-		recalculateLatencyMap(r);
-
 	} else {
-
-		// Invalid r
-		return false;
+		splice(std::next(begin(), r), *this,
+			std::next(begin(), p),
+			std::next(begin(), q + 1));
 	}
 
+	/* Update latency map */
+	recalculateLatencyMap(min);
+
 	/* Update lower and upper bounds */
 	if (lb) *lb = min - 1;
 	if (ub) *ub = max + 1;
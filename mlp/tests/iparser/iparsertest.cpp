@@ -1,9 +1,16 @@
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include "argparser.h"
 #include "bksparser.h"
+#include "cache.h"
+#include "image.h"
 #include "iparser.h"
+#include "onetree.h"
+#include "registry.h"
 #include "solution.h"
 
 namespace fs = std::filesystem;
@@ -31,6 +38,231 @@ struct options_t
 		assert(instance_ptr->IsValid());
 		assert(instance_ptr->GetSourceFilePath() == instance_path);
 
+		// Test gamma set ordering
+		auto gammaset = instance_ptr->GetGammaSet();
+		auto n = instance_ptr->GetSize();
+		for (Node i = 0; i < n; ++i) {
+			auto const* di = (*instance_ptr)[i];
+			auto closer = [di] (Node a, Node b) {
+				return di[a] < di[b] || (di[a] == di[b] && a < b);
+			};
+			auto neighbours = gammaset->getClosestNeighbours(i);
+			assert(std::is_sorted(neighbours.begin(), neighbours.end(), closer));
+			std::vector<bool> in_gamma(n, false);
+			for (auto const& j : neighbours)
+				in_gamma[j] = true;
+			auto farthest = neighbours[neighbours.size() - 1];
+			for (Node j = 0; j < n; ++j)
+				assert(in_gamma[j] || j == i || closer(farthest, j));
+		}
+
+		// Test parallel gamma set construction
+		auto k = std::min(n - 1, (std::size_t) 10);
+		ds::GammaSet serial(*instance_ptr, k, 1), parallel(*instance_ptr, k, 3);
+		for (Node i = 0; i < n; ++i)
+			assert(serial.getClosestNeighbours(i) ==
+				parallel.getClosestNeighbours(i));
+
+		// Test reverse lists and membership
+		std::vector<std::size_t> reverse_count(n, 0);
+		for (Node i = 0; i < n; ++i) {
+			auto row = gammaset->getClosestNeighbours(i);
+			for (Node j = 0; j < n; ++j)
+				assert(gammaset->isCandidate(i, j) ==
+					(std::find(row.begin(), row.end(), j) != row.end()));
+			for (auto const& j : row)
+				++reverse_count[j];
+		}
+		for (Node j = 0; j < n; ++j) {
+			auto reverse = gammaset->getReverseNeighbours(j);
+			assert(reverse.size() == reverse_count[j]);
+			assert(std::is_sorted(reverse.begin(), reverse.end()));
+			for (auto const& i : reverse)
+				assert(gammaset->isCandidate(i, j));
+		}
+
+		// Test gamma set views
+		auto full = instance_ptr->GetGammaSet(k);
+		auto small_k = std::max(k / 2, (std::size_t) 1);
+		instance_ptr->SetK(small_k);
+		auto view = instance_ptr->GetGammaSet();
+		assert(view->getK() == small_k && view->data() == full->data());
+		for (Node i = 0; i < n; ++i)
+			for (auto const& j : view->getReverseNeighbours(i))
+				assert(view->getClosestNeighbours(j).size() == small_k &&
+					view->isCandidate(j, i));
+		for (Node i = 0; i < n; ++i) {
+			auto row = serial.getClosestNeighbours(i);
+			assert(std::equal(row.begin(), std::next(row.begin(), small_k),
+				view->getClosestNeighbours(i).begin()));
+		}
+		instance_ptr->SetK(DEFAULT_GAMMA_K);
+
+		// Test alpha-nearness
+		ds::OneTree tree(*instance_ptr);
+		if (n <= 150) {
+			ds::OneTree ascent_tree(*instance_ptr,
+				ds::OneTree::Ascent(*instance_ptr));
+			assert(ascent_tree.getLowerBound() >= tree.getLowerBound());
+		}
+		std::vector<double> alphas, beta;
+		std::vector<Node> mark(n, 0);
+		for (Node i = 0; i < n; ++i) {
+			tree.computeAlphas(i, alphas, beta, mark);
+			assert(std::all_of(alphas.begin(), alphas.end(),
+				[] (double alpha) { return alpha >= 0; }));
+		}
+		ds::GammaSet alpha(*instance_ptr, k, 3, ds::GammaSet::Strategy::Alpha);
+		for (Node i = 0; i < n; ++i) {
+			std::vector<bool> seen(n, false);
+			for (auto const& j : alpha.getClosestNeighbours(i)) {
+				assert(j != i && !seen[j]);
+				seen[j] = true;
+			}
+		}
+
+		// Test spatial gamma set construction
+		if (instance_ptr->HasConsistentCoordinates()) {
+			using Strategy = ds::GammaSet::Strategy;
+			ds::GammaSet grid(*instance_ptr, k, 3, Strategy::Grid);
+			ds::GammaSet quadrant(*instance_ptr, k, 3, Strategy::Quadrant);
+			for (Node i = 0; i < n; ++i) {
+				assert(serial.getClosestNeighbours(i) ==
+					grid.getClosestNeighbours(i));
+				auto neighbours = quadrant.getClosestNeighbours(i);
+				std::vector<bool> seen(n, false);
+				for (auto const& j : neighbours) {
+					assert(j != i && !seen[j]);
+					seen[j] = true;
+				}
+			}
+		}
+
+		// Test deferred parsing of the data section
+		auto lazy_instance_opt =
+			InstanceParser::Open(instance_path)->ParseSpecification();
+		assert(lazy_instance_opt);
+		auto lazy_instance = *lazy_instance_opt;
+		assert(!lazy_instance->IsLoaded());
+		assert(lazy_instance->GetName() == instance_ptr->GetName());
+		assert(lazy_instance->GetSize() == instance_ptr->GetSize());
+		lazy_instance->Prefetch();
+		assert(lazy_instance->Load());
+		assert(lazy_instance->IsLoaded());
+		assert((*lazy_instance)[0][1] == (*instance_ptr)[0][1]);
+
+		// Test instance registry
+		auto registry = InstanceRegistry::GetInstance();
+		auto shared_instance_opt = registry->Get(instance_path);
+		assert(shared_instance_opt);
+		assert(registry->Get(instance_path) == shared_instance_opt);
+		registry->Remove(instance_path);
+		assert(registry->Get(instance_path) != shared_instance_opt);
+		auto shared_instance = *registry->Get(instance_path);
+		assert(shared_instance->IsShared());
+		shared_instance->SetK(small_k);
+		assert(shared_instance->GetConfig().k == DEFAULT_GAMMA_K);
+		Instance::Config small_config;
+		small_config.k = small_k;
+		auto small_instance_opt = registry->Get(instance_path, small_config);
+		assert(small_instance_opt && *small_instance_opt != shared_instance);
+		assert((*small_instance_opt)->GetGammaSet()->getK() == small_k);
+		assert(shared_instance->GetGammaSet()->getK() ==
+			std::min(n - 1, DEFAULT_GAMMA_K));
+		Instance::Config released_config;
+		released_config.k = small_k + 1;
+		std::weak_ptr<Instance> released =
+			*registry->Get(instance_path, released_config);
+		assert(released.expired()); // The registry does not own it
+		auto reparsed = *registry->Get(instance_path, released_config);
+		assert(reparsed->IsShared());
+		assert(registry->Get(instance_path, released_config) == reparsed);
+
+		// Test instance image round trip
+		auto image_size = InstanceImage::GetSize(*instance_ptr);
+		auto image = std::shared_ptr<char>(new char[image_size],
+			std::default_delete<char[]>());
+		bool written = InstanceImage::Write(*instance_ptr, 42, image.get(),
+			image_size);
+		assert(written);
+		assert(InstanceImage::GetStamp(image.get(), image_size) == 42u);
+		auto image_instance_opt = InstanceImage::Read(image.get(),
+			image_size, image);
+		assert(image_instance_opt);
+		auto image_instance = *image_instance_opt;
+		assert(image_instance->IsValid());
+		assert(image_instance->GetName() == instance_ptr->GetName());
+		assert(image_instance->GetSize() == instance_ptr->GetSize());
+		for (Node i = 0; i < instance_ptr->GetSize(); ++i) {
+			for (Node j = 0; j < instance_ptr->GetSize(); ++j)
+				assert((*image_instance)[i][j] == (*instance_ptr)[i][j]);
+			assert(image_instance->GetGammaSet()->getClosestNeighbours(i) ==
+				instance_ptr->GetGammaSet()->getClosestNeighbours(i));
+		}
+
+		// Test binary cache
+		auto cache_folder = fs::temp_directory_path() / "iparsertest";
+		fs::create_directories(cache_folder);
+		auto cache_source = (cache_folder /
+			fs::path(instance_path).filename()).string();
+		fs::copy_file(instance_path, cache_source,
+			fs::copy_options::overwrite_existing);
+		fs::remove(InstanceCache::GetPath(cache_source));
+		InstanceCache::SetEnabled(true);
+		auto source_opt = InstanceParser::Open(cache_source)->Parse();
+		assert(source_opt && !(*source_opt)->HasGammaSet());
+		assert(!fs::exists(InstanceCache::GetPath(cache_source)));
+		(*source_opt)->GetGammaSet(); // Written along
+		assert(fs::exists(InstanceCache::GetPath(cache_source)));
+		auto cached_opt =
+			InstanceParser::Open(cache_source)->ParseSpecification();
+		assert(cached_opt && (*cached_opt)->IsLoaded());
+		assert((*cached_opt)->HasGammaSet()); // Read, not built
+		assert((*cached_opt)->GetGammaSet() == (*cached_opt)->GetGammaSet());
+		assert((*cached_opt)->GetSourceFilePath() == cache_source);
+		for (Node i = 0; i < n; ++i) {
+			for (Node j = 0; j < n; ++j)
+				assert((**cached_opt)[i][j] == (*instance_ptr)[i][j]);
+			assert((*cached_opt)->GetGammaSet()->getClosestNeighbours(i) ==
+				instance_ptr->GetGammaSet()->getClosestNeighbours(i));
+		}
+		std::ofstream(cache_source, std::ios::app) << "\n";
+		auto outdated_opt =
+			InstanceParser::Open(cache_source)->ParseSpecification();
+		assert(outdated_opt && !(*outdated_opt)->IsLoaded());
+		InstanceCache::SetEnabled(false);
+		fs::remove_all(cache_folder);
+
+		// Test every edge weight format
+		if (n <= 60) {
+			auto format_folder = fs::temp_directory_path() / "iparsertest";
+			fs::create_directories(format_folder);
+			for (std::string format : { "FULL_MATRIX", "UPPER_ROW",
+				"LOWER_ROW", "UPPER_DIAG_ROW", "LOWER_DIAG_ROW", "UPPER_COL",
+				"LOWER_COL", "UPPER_DIAG_COL", "LOWER_DIAG_COL" }) {
+				auto format_path = (format_folder / (format + ".tsp")).string();
+				write_instance(*instance_ptr, format, format_path);
+				auto format_opt = InstanceParser::Open(format_path)->Parse();
+				assert(format_opt);
+
+				// Also decoded in parallel chunks
+				InstanceParser::SetChunkSize(16);
+				auto chunked_opt =
+					InstanceParser::Open(format_path)->ParseSpecification();
+				assert(chunked_opt);
+				(*chunked_opt)->SetThreadCount(3);
+				assert((*chunked_opt)->Load());
+				InstanceParser::SetChunkSize(1 << 18);
+
+				for (Node i = 0; i < n; ++i)
+					for (Node j = 0; j < n; ++j) {
+						assert((**format_opt)[i][j] == (*instance_ptr)[i][j]);
+						assert((**chunked_opt)[i][j] == (*instance_ptr)[i][j]);
+					}
+			}
+			fs::remove_all(format_folder);
+		}
+
 		// Test creating solution
 		auto solution = Solution(instance_ptr);
 		assert(solution.IsValid());
@@ -123,6 +355,84 @@ struct options_t
 		}
 	}
 
+	// Writes the instance with the given EDGE_WEIGHT_FORMAT
+	void write_instance(Instance const& instance, std::string const& format,
+		std::string const& path)
+	{
+		auto n = instance.GetSize();
+		bool column = format.find("_COL") != std::string::npos;
+		bool diagonal = format.find("DIAG") != std::string::npos;
+		bool lower = format.find("LOWER") == 0;
+		bool full = format == "FULL_MATRIX";
+		std::ofstream ofs(path);
+		ofs << "NAME: " << instance.GetName() << "\n"
+			<< "TYPE: TSP\n"
+			<< "DIMENSION: " << n << "\n"
+			<< "EDGE_WEIGHT_TYPE: EXPLICIT\n"
+			<< "EDGE_WEIGHT_FORMAT: " << format << "\n"
+			<< "EDGE_WEIGHT_SECTION\n";
+		for (Node a = 0; a < n; ++a) {
+			for (Node b = 0; b < n; ++b) {
+				auto row = column ? b : a, col = column ? a : b;
+				if (full || (row == col ? diagonal : (row > col) == lower))
+					ofs << instance[row][col] << " ";
+			}
+			ofs << "\n";
+		}
+		ofs << "EOF\n";
+	}
+
+	// Distances of the coordinate based edge weight types
+	void test_edge_weight_types()
+	{
+		auto explicit_opt = InstanceParser::Open(
+			std::string(DATAPATH) + "/tests/clusters60.tsp")->Parse();
+		auto coords_opt = InstanceParser::Open(
+			std::string(DATAPATH) + "/tests/clusters60c.tsp")->Parse();
+		assert(explicit_opt && coords_opt);
+		auto n = (*explicit_opt)->GetSize();
+		for (Node i = 0; i < n; ++i)
+			for (Node j = 0; j < n; ++j)
+				assert((**coords_opt)[i][j] == (**explicit_opt)[i][j]);
+
+		struct case_t {
+			std::string type;
+			std::string coords;
+			Dist d01, d02, d12;
+		};
+		std::vector<case_t> cases = {
+			{ "EUC_2D", "0 0\n1 1\n3 4", 1, 5, 4 },
+			{ "CEIL_2D", "0 0\n1 1\n3 4", 2, 5, 4 },
+			{ "MAN_2D", "0 0\n1 1\n3 4", 2, 7, 5 },
+			{ "ATT", "0 0\n1 1\n3 4", 1, 2, 2 },
+			{ "GEO", "38.24 20.42\n39.57 26.15\n40.56 25.32", 509, 501, 126 },
+		};
+		auto folder = fs::temp_directory_path() / "iparsertest";
+		fs::create_directories(folder);
+		for (auto const& c : cases) {
+			auto path = (folder / (c.type + ".tsp")).string();
+			{
+				std::ofstream ofs(path);
+				std::istringstream coords(c.coords);
+				ofs << "NAME: " << c.type << "\nTYPE: TSP\nDIMENSION: 3\n"
+					<< "EDGE_WEIGHT_TYPE: " << c.type << "\n"
+					<< "NODE_COORD_SECTION\n";
+				std::string line;
+				for (int node = 1; std::getline(coords, line); ++node)
+					ofs << node << " " << line << "\n";
+				ofs << "EOF\n";
+			}
+			auto instance_opt = InstanceParser::Open(path)->Parse();
+			assert(instance_opt);
+			auto const& instance = **instance_opt;
+			assert(instance[0][1] == c.d01 && instance[1][0] == c.d01);
+			assert(instance[0][2] == c.d02 && instance[2][0] == c.d02);
+			assert(instance[1][2] == c.d12 && instance[2][1] == c.d12);
+			assert(instance[1][1] == 0);
+		}
+		fs::remove_all(folder);
+	}
+
 	void dump(Solution const& solution)
 	{
 		std::cout << "--------------------\n";
@@ -154,13 +464,19 @@ int main(int argc, char **argv)
 
 	auto bks_instance = BKSParser::GetInstance();
 
+	// Caches are tested on copies of the instances
+	InstanceCache::SetEnabled(false);
+
+	options.test_edge_weight_types();
+
 	if (options.ifile.empty()) {
-		for (const auto& entry : fs::directory_iterator(DATAPATH)) {
-			auto path = entry.path();
-			if (path.extension() != ".tsp")
-				continue; // Accept only tsp instances
-			options.open_instance(path.string());
-		}
+		for (auto folder : { DATAPATH, DATAPATH "/tests" })
+			for (const auto& entry : fs::directory_iterator(folder)) {
+				auto path = entry.path();
+				if (path.extension() != ".tsp")
+					continue; // Accept only tsp instances
+				options.open_instance(path.string());
+			}
 	} else {
 		std::string instance_path = std::string(DATAPATH) + "/" + options.ifile;
 		options.open_instance(instance_path);
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+#include "cache.h"
+#include "iparser.h"
+#include "ls.h"
+#include "parallel.h"
+#include "solution.h"
+
+// Cost of the solution from scratch (without the latency map)
+Cost GetLatencyCost(Solution const& s)
+{
+	auto n = s.GetInstance()->GetSize();
+	Cost latency = 0, cost = 0;
+	for (std::size_t p = 1; p <= n; ++p) {
+		latency += s.GetDist(s.Get(p - 1), s.Get(p));
+		cost += latency;
+	}
+	return cost;
+}
+
+void CheckSolution(Solution const& s)
+{
+	assert(s.IsValid());
+	assert(s.GetCost() == GetLatencyCost(s));
+}
+
+SharedInstance OpenInstance(std::string const& filename)
+{
+	auto instance_opt = InstanceParser::Open(
+		std::string(DATAPATH) + "/" + filename)->Parse();
+	assert(instance_opt);
+	return *instance_opt;
+}
+
+// Evaluate of every operator must match the cost change of
+// Commit (and Apply, which only takes improving moves)
+void TestOperators(SharedInstance const& instance)
+{
+	std::default_random_engine rng(1);
+	auto gammaset = instance->GetGammaSet();
+	auto n = instance->GetSize();
+	std::uniform_int_distribution<std::size_t> pos_unif(0, n);
+	std::uniform_int_distribution<std::size_t> k_unif(0, gammaset->getK() - 1);
+	std::size_t backward_chains = 0;
+	Solution solution(instance, 3, rng);
+	for (std::size_t nl = 0; nl < ChainPipeline::size; ++nl) {
+		solution = Solution(instance, 3, rng);
+		CheckSolution(solution);
+		std::size_t valid = 0;
+		for (int t = 0; t < 2000; ++t) {
+			// Out of range positions too, or gamma set
+			// neighbours, as the local search does
+			auto i = pos_unif(rng), j = pos_unif(rng), r = pos_unif(rng);
+			if (t % 2 && i > 0 && i < n) {
+				auto const& neighbours = gammaset->getClosestNeighbours(solution.Get(i));
+				j = solution.GetIndexOf(neighbours[k_unif(rng)]);
+				r = solution.GetIndexOf(neighbours[k_unif(rng)]);
+			}
+			auto cost = solution.GetCost();
+			ChainPipeline::Visit(nl, [&](auto op) {
+				using Operator = typename decltype(op)::type;
+				auto delta = Operator::Evaluate(solution, *gammaset, i, j, r);
+				Solution applied(solution);
+				std::size_t lb = 0, ub = n;
+				bool improved = Operator::Apply(applied, *gammaset,
+					i, j, r, &lb, &ub);
+				assert(improved == (delta && *delta < 0));
+				if (!delta) {
+					assert(applied.GetCost() == cost);
+					return false;
+				}
+				++valid;
+				if (Operator::activates_range && j < i && improved)
+					++backward_chains;
+				Solution committed(solution);
+				assert(Operator::Commit(committed, *gammaset,
+					i, j, r, nullptr, nullptr) || Operator::activates_range);
+				if (improved) {
+					CheckSolution(applied);
+					assert(applied.GetCost() == cost + *delta);
+					assert(lb <= ub && ub <= n);
+				}
+				if (!Operator::activates_range) {
+					CheckSolution(committed);
+					assert(committed.GetCost() == cost + *delta);
+				}
+				// Moves along, so that later tries see other tours
+				if (improved)
+					solution = applied;
+				return false;
+			});
+		}
+		assert(valid > 0);
+	}
+	assert(backward_chains > 0);
+}
+
+// Reversals and rearrangements must keep the latency map right
+void TestRearrange(SharedInstance const& instance)
+{
+	std::default_random_engine rng(2);
+	auto n = instance->GetSize();
+	Solution solution(instance, 3, rng);
+	for (int t = 0; t < 200; ++t) {
+		std::uniform_int_distribution<std::size_t> client_unif(1, n - 1);
+		auto p = client_unif(rng), q = client_unif(rng);
+		if (p > q) std::swap(p, q);
+		solution.Reverse(p, q);
+		CheckSolution(solution);
+		std::vector<Node> segment;
+		for (auto k = p; k <= q; ++k)
+			segment.push_back(solution.Get(k));
+		std::shuffle(segment.begin(), segment.end(), rng);
+		solution.Rearrange(p, segment.begin(), segment.end());
+		CheckSolution(solution);
+		for (auto k = p; k <= q; ++k)
+			assert(solution.Get(k) == segment[k - p]);
+	}
+}
+
+// Every order and descent must lower the cost, by as much as
+// the gains counted, with as many moves as applied
+void TestDescents(SharedInstance const& instance)
+{
+	using Order = LocalSearch::Order;
+	using Descent = LocalSearch::Descent;
+	for (auto order : { Order::Fixed, Order::Random, Order::Adaptive,
+		Order::Bandit }) {
+		for (auto descent : { Descent::FirstImprovement,
+			Descent::BestImprovement }) {
+			std::default_random_engine rng(3);
+			Solution solution(instance, 3, rng);
+			auto cost = solution.GetCost();
+			ChainLocalSearch ls(3);
+			ls.SetNeighbourhoodOrder(order);
+			ls.SetDescent(descent);
+			auto improvements = ls.findLocalMinimum(solution);
+			CheckSolution(solution);
+			assert(improvements > 0 && solution.GetCost() < cost);
+			if constexpr (LocalSearch::stats_enabled) {
+				Cost gain = 0;
+				unsigned long long applied = 0;
+				for (auto const& nbh_stats : ls.GetStats()) {
+					assert(nbh_stats.applied <= nbh_stats.evaluations);
+					gain += nbh_stats.gain;
+					applied += nbh_stats.applied;
+				}
+				assert(gain == cost - solution.GetCost());
+				assert(applied == (unsigned long long) improvements);
+			}
+
+			// Again, from the nodes touched by a perturbation
+			std::vector<Node> touched_nodes;
+			ls.perturbSolution(solution, 5, &touched_nodes);
+			ls.findLocalMinimum(solution, &touched_nodes);
+			CheckSolution(solution);
+		}
+	}
+}
+
+// The best improvement descent must reach the same
+// solution whatever the number of threads
+void TestParallelDescent(SharedInstance const& instance)
+{
+	std::vector<Node> expected;
+	for (std::size_t threads : { 0, 1, 3 }) {
+		std::default_random_engine rng(4);
+		Solution solution(instance, 3, rng);
+		ChainLocalSearch ls(4);
+		ls.SetDescent(LocalSearch::Descent::BestImprovement, threads ?
+			std::make_shared<parallel::ThreadPool>(threads) : nullptr);
+		ls.findLocalMinimum(solution);
+		CheckSolution(solution);
+		std::vector<Node> nodes(solution.begin(), solution.end());
+		if (expected.empty())
+			expected = nodes;
+		assert(nodes == expected);
+	}
+}
+
+// Solutions and searches over other memory resources
+void TestResources(SharedInstance const& instance)
+{
+	auto resource = std::make_shared<std::pmr::unsynchronized_pool_resource>();
+	std::default_random_engine rng(5);
+	Solution solution(instance, 3, rng, resource);
+	CheckSolution(solution);
+	Solution copy(solution); // same resource
+	Solution other(solution, nullptr); // default resource
+	assert(std::equal(copy.begin(), copy.end(), solution.begin()));
+	assert(std::equal(other.begin(), other.end(), solution.begin()));
+
+	LocalSearch ls(5);
+	ls.SetScratchResource(
+		std::make_shared<std::pmr::unsynchronized_pool_resource>());
+	for (int t = 0; t < 3; ++t) {
+		ls.findLocalMinimum(copy);
+		CheckSolution(copy);
+		other = copy;
+		CheckSolution(other);
+		assert(std::equal(other.begin(), other.end(), copy.begin()));
+		ls.perturbSolution(copy, 5);
+	}
+}
+
+// Every perturbation must keep the solution valid, for sizes
+// beyond the number of clients too
+void TestPerturbations(SharedInstance const& instance)
+{
+	using Perturbation = LocalSearch::Perturbation;
+	auto n = instance->GetSize();
+	for (auto perturbation : { Perturbation::Moves,
+		Perturbation::DoubleBridge, Perturbation::Reversal,
+		Perturbation::MultiShift, Perturbation::Bandit }) {
+		std::default_random_engine rng(6);
+		LocalSearch ls(6);
+		ls.SetPerturbation(perturbation);
+		for (std::size_t size : { (std::size_t) 1, (std::size_t) 2,
+			(std::size_t) 5, n / 2, n - 1, n + 5 }) {
+			Solution solution(instance, 3, rng);
+			std::vector<Node> touched_nodes;
+			ls.perturbSolution(solution, size, &touched_nodes);
+			CheckSolution(solution);
+			for (auto const& node : touched_nodes)
+				assert(node > 0 && node < n);
+			ls.RewardPerturbation(1);
+		}
+
+		// Shifting every client used to sort the tour by id
+		if (perturbation == Perturbation::MultiShift) {
+			Solution solution(instance, 3, rng);
+			ls.perturbSolution(solution, n - 1);
+			CheckSolution(solution);
+			bool sorted = true;
+			for (Node p = 1; p < n; ++p)
+				sorted = sorted && solution.Get(p) == p;
+			assert(!sorted);
+		}
+	}
+}
+
+// Once no window improves, none of their orders may be
+// cheaper, as found by trying every permutation
+void TestWindows(SharedInstance const& instance)
+{
+	auto n = instance->GetSize();
+	for (std::size_t w = 2; w <= 6; ++w) {
+		std::default_random_engine rng(7);
+		Solution solution(instance, 3, rng);
+		LocalSearch ls(7);
+		for (int pass = 0; pass < 100; ++pass) {
+			auto cost = solution.GetCost();
+			int improved = ls.reoptimizeWindows(solution, w);
+			CheckSolution(solution);
+			assert((improved > 0) == (solution.GetCost() < cost));
+			if (!improved)
+				break;
+		}
+		assert(LocalSearch(7).reoptimizeWindows(solution, w) == 0);
+
+		Solution trial(solution);
+		std::vector<Node> window(w);
+		for (std::size_t a = 1; a + w <= n; ++a) {
+			for (std::size_t t = 0; t < w; ++t)
+				window[t] = solution.Get(a + t);
+			std::sort(window.begin(), window.end());
+			do {
+				trial.Rearrange(a, window.begin(), window.end());
+				assert(trial.GetCost() >= solution.GetCost());
+			} while (std::next_permutation(window.begin(), window.end()));
+			trial = solution;
+		}
+	}
+}
+
+int main()
+{
+	// Tested instances are left as they are
+	InstanceCache::SetEnabled(false);
+
+	for (auto filename : { "dantzig42.tsp", "gr48.tsp" }) {
+		std::cout << "Testing " << filename << "..." << std::endl;
+		auto instance = OpenInstance(filename);
+		TestOperators(instance);
+		TestRearrange(instance);
+		TestDescents(instance);
+		TestParallelDescent(instance);
+		TestResources(instance);
+		TestPerturbations(instance);
+		TestWindows(instance);
+	}
+	return 0;
+}
\ No newline at end of file
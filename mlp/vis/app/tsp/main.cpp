@@ -9,7 +9,7 @@
 #include "pplot.h"
 #include "tspw.h"
 
-#include "iparser.h"
+#include "registry.h"
 #include "solution.h"
 #include "population.h"
 
@@ -271,6 +271,12 @@ int main(int argc, char** argv)
 
 		.build();
 
+	if (options.gammak != 0) {
+		Instance::Config config;
+		config.k = options.gammak;
+		InstanceRegistry::GetInstance()->SetDefaultConfig(config);
+	}
+
 	std::shared_ptr<Instance> instance_ptr;
 
 	if (!options.sfile.empty()) {
@@ -296,12 +302,12 @@ int main(int argc, char** argv)
 		options.set_plotter(std::make_shared<SolutionPlotter>(solution_ptr));
 	} else if (!options.ifile.empty()) {
 		std::string ifilepath = std::string(DATAPATH) + "/" + options.ifile;
-		auto iparser = InstanceParser::Open(ifilepath);
+		auto registry = InstanceRegistry::GetInstance();
 
 		std::cout << "Parsing instance " << options.ifile << "... ";
-		auto instance_ptr_opt = iparser->Parse();
+		auto instance_ptr_opt = registry->Get(ifilepath);
 
-		if (!instance_ptr_opt)
+		if (!instance_ptr_opt || !(*instance_ptr_opt)->Load())
 			return 1;
 
 		std::cout << "OK\n";
@@ -331,9 +337,6 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
-	if (options.gammak != 0)
-		instance_ptr->SetK(options.gammak);
-
 	if (!instance_ptr->GetPositionMatrix()) {
 		std::cerr << "No position matrix.\n";
 		return 1;